@@ -0,0 +1,665 @@
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+
+#include "qsscompileddocument.h"
+#include "qssdocumentview.h"
+#include "qssinstrument.h"
+#include "qsssnapshot.h"
+#include "qsswriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+// Each benchmark reports how many allocations it made. Qt allocates the
+// storage of QString, QByteArray and QList with malloc, not operator new,
+// so with glibc the C allocator itself is interposed: these definitions
+// take precedence over the library's and forward to its internal entry
+// points, and libstdc++'s operator new lands in them too. Elsewhere only
+// operator new can be replaced, which misses Qt's containers, so the
+// metric is reported under a name that says so.
+namespace
+{
+    std::atomic<quint64> Allocations{ 0 };
+}
+
+#if defined(__GLIBC__)
+
+namespace
+{
+    constexpr const char* AllocationMetric = "allocations_per_op";
+}
+
+extern "C"
+{
+    void* __libc_malloc(std::size_t size);
+    void* __libc_calloc(std::size_t count, std::size_t size);
+    void* __libc_realloc(void* pointer, std::size_t size);
+    void* __libc_memalign(std::size_t alignment, std::size_t size);
+    void  __libc_free(void* pointer);
+
+    void* malloc(std::size_t size) noexcept
+    {
+        Allocations.fetch_add(1, std::memory_order_relaxed);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(std::size_t count, std::size_t size) noexcept
+    {
+        Allocations.fetch_add(1, std::memory_order_relaxed);
+        return __libc_calloc(count, size);
+    }
+
+    // Counted like a fresh allocation, since growing may move the block
+    void* realloc(void* pointer, std::size_t size) noexcept
+    {
+        Allocations.fetch_add(1, std::memory_order_relaxed);
+        return __libc_realloc(pointer, size);
+    }
+
+    // std::pmr::new_delete_resource allocates through the aligned operator new
+    void* aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+    {
+        Allocations.fetch_add(1, std::memory_order_relaxed);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** pointer, std::size_t alignment, std::size_t size) noexcept
+    {
+        Allocations.fetch_add(1, std::memory_order_relaxed);
+        *pointer = __libc_memalign(alignment, size);
+        return *pointer != nullptr || size == 0 ? 0 : ENOMEM;
+    }
+
+    void free(void* pointer) noexcept
+    {
+        __libc_free(pointer);
+    }
+}
+
+#else
+
+namespace
+{
+    constexpr const char* AllocationMetric = "operator_new_calls_per_op";
+}
+
+void* operator new(std::size_t size)
+{
+    Allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (auto* pointer = std::malloc(size != 0 ? size : 1))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+// std::pmr::new_delete_resource allocates through the aligned forms
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    Allocations.fetch_add(1, std::memory_order_relaxed);
+    const auto align = static_cast<std::size_t>(alignment);
+
+    if (auto* pointer = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+#endif
+
+namespace
+{
+    // Deterministic QDarkStyleSheet-like corpus. Only the raw output of
+    // mt19937 is used, which the standard fixes, so a seed produces the same
+    // sheet with every compiler.
+    class Corpus
+    {
+    public:
+
+        Corpus(quint32 seed = 1) : m_random{ seed } {}
+
+        QString sheet(int rules)
+        {
+            QString result;
+
+            for (int i = 0; i < rules; ++i)
+            {
+                if (i % 10 == 0)
+                {
+                    result += QString{ "/* ---- section %1 ---- */\n" }.arg(i / 10);
+                }
+
+                result += selector(i) + " {\n";
+
+                for (auto count = 2 + pick(5); count > 0; --count)
+                {
+                    result += "    " + declaration() + "\n";
+                }
+
+                result += "}\n\n";
+            }
+
+            return result;
+        }
+
+    private:
+
+        std::size_t pick(std::size_t count) { return static_cast<std::size_t>(m_random() % count); }
+
+        template <std::size_t N>
+        const char* pick(const char* const (&options)[N]) { return options[pick(N)]; }
+
+        QString element(bool last, int rule)
+        {
+            static const char* const Types[] = { "QPushButton", "QToolButton", "QComboBox", "QScrollBar", "QTabBar",
+                "QTreeView", "QHeaderView", "QCheckBox", "QRadioButton", "QSlider", "QLineEdit", "QMenu", "QFrame",
+                "QDockWidget", "QMainWindow", "QAbstractItemView", "QGroupBox", "QSpinBox", "QProgressBar", "QLabel" };
+            static const char* const Params[] = { "[flat=\"true\"]", "[readOnly=\"true\"]", "[orientation=\"horizontal\"]",
+                "[frameShape=\"0\"]", "[accessibleName=\"toolbar\"]" };
+            static const char* const SubControls[] = { "::handle", "::add-line", "::sub-line", "::drop-down", "::indicator",
+                "::tab", "::section", "::item", "::menu-indicator", "::groove", "::chunk", "::title" };
+            static const char* const States[] = { ":hover", ":pressed", ":checked", ":disabled", ":!enabled", ":focus",
+                ":selected", ":on", ":checked:hover", ":!selected:hover" };
+
+            QString result = pick(Types);
+
+            if (pick(8) == 0)
+            {
+                result += QString{ "#widget%1" }.arg(rule);
+            }
+
+            if (pick(4) == 0)
+            {
+                result += pick(Params);
+            }
+
+            if (last && pick(2) == 0)
+            {
+                result += pick(SubControls);
+            }
+
+            if (last && pick(2) == 0)
+            {
+                result += pick(States);
+            }
+
+            return result;
+        }
+
+        QString selector(int rule)
+        {
+            static const char* const Combinators[] = { " ", " > ", " ", " ~ " };
+            QString result;
+
+            // Mostly one or two elements, with the occasional long chain
+            for (auto depth = pick(6) == 0 ? 3 + pick(4) : 1 + pick(2); depth > 0; --depth)
+            {
+                result += element(depth == 1, rule);
+
+                if (depth > 1)
+                {
+                    result += pick(Combinators);
+                }
+            }
+
+            return result;
+        }
+
+        QString declaration()
+        {
+            static const char* const Declarations[] = { "background-color: #19232D;", "border: 1px solid \"#455364\";",
+                "color: #DFE1E2;", "padding: 4px 8px;", "border-radius: 4px;", "min-height: 20px;",
+                "image: url(\":/qss_icons/rc/arrow_down.png\");", "selection-background-color: #346792;",
+                "font: 10pt \"Segoe UI\";", "margin: 0px;", "outline: none;", "background: transparent;",
+                "border-image: url(\":/qss_icons/rc/base_icon.png\") 0 0 0 0 stretch stretch;",
+                "background-color: qlineargradient(x1: 0, y1: 0, x2: 0, y2: 1, stop: 0 #37414F, stop: 1 #455364);",
+                "qproperty-alignment: AlignCenter;", "subcontrol-origin: margin;", "subcontrol-position: top left;" };
+            return pick(Declarations);
+        }
+
+        std::mt19937 m_random;
+    };
+
+    // The comment stripping and fragment splitting used before the lexer
+    std::size_t LegacySplit(const QString& qss)
+    {
+        std::regex regRemoveComments(R"((//.*?$|/\*[\S\s]*?\*/)|(\'(?:\\.|[^\\\'])*\'|"(?:\\.|[^\\"])*"))");
+
+        std::string str = qss.toStdString();
+        std::string strNoComments = std::regex_replace(str, regRemoveComments, "$2");
+        std::replace(strNoComments.begin(), strNoComments.end(), '\n', ' ');
+
+        QString input = QString::fromStdString(strNoComments);
+        std::size_t fragments = 0;
+        auto insideStr = false;
+        QString fragment;
+
+        for (auto i = 0; i < input.size(); ++i)
+        {
+            fragment += input.at(i);
+
+            if (input.at(i) == '"')
+            {
+                insideStr = !insideStr;
+            }
+
+            if (!insideStr && input.at(i) == '}')
+            {
+                fragments++;
+                fragment.clear();
+            }
+        }
+
+        return fragments;
+    }
+
+    struct Options
+    {
+        int         maxRules = 100000;
+        double      seconds = 0.2;      // minimum measured time per benchmark
+        std::string filter;
+        QString     profile;
+    };
+
+    class Suite
+    {
+    public:
+
+        Suite(const Options& options) : m_options{ options } {}
+        ~Suite() { std::cout << (m_first ? "[]" : "\n]") << std::endl; }
+
+        // Runs function until the time budget is spent and reports one JSON
+        // object. ops is the number of operations a call performs and bytes
+        // the input it consumes, 0 when throughput means nothing.
+        template <typename F>
+        void run(const std::string& name, int rules, std::size_t ops, qint64 bytes, F function)
+        {
+            if (!m_options.filter.empty() && name.find(m_options.filter) == std::string::npos)
+            {
+                return;
+            }
+
+            // One untimed call warms caches and atom tables and calibrates
+            QElapsedTimer timer;
+            timer.start();
+            m_sink += function();
+            const auto once = std::max<qint64>(timer.nsecsElapsed(), 1);
+            const auto iterations = std::max<qint64>(1, std::min<qint64>(100000, static_cast<qint64>(m_options.seconds * 1e9 / once)));
+
+            const auto allocations = Allocations.load();
+            timer.restart();
+
+            for (qint64 i = 0; i < iterations; ++i)
+            {
+                m_sink += function();
+            }
+
+            report(name, rules, iterations, ops, bytes, static_cast<double>(timer.nsecsElapsed()), static_cast<double>(Allocations.load() - allocations));
+        }
+
+        // As above, but each call gets a fresh result of prepare(), which is
+        // neither timed nor counted, e.g. to measure destruction alone
+        template <typename P, typename F>
+        void run(const std::string& name, int rules, std::size_t ops, qint64 bytes, P prepare, F function)
+        {
+            if (!m_options.filter.empty() && name.find(m_options.filter) == std::string::npos)
+            {
+                return;
+            }
+
+            QElapsedTimer timer;
+            auto input = prepare();
+            timer.start();
+            m_sink += function(input);
+            const auto once = std::max<qint64>(timer.nsecsElapsed(), 1);
+            const auto iterations = std::max<qint64>(1, std::min<qint64>(100000, static_cast<qint64>(m_options.seconds * 1e9 / once)));
+
+            qint64 elapsed = 0;
+            quint64 allocated = 0;
+
+            for (qint64 i = 0; i < iterations; ++i)
+            {
+                auto prepared = prepare();
+                const auto allocations = Allocations.load();
+                timer.restart();
+                m_sink += function(prepared);
+                elapsed += timer.nsecsElapsed();
+                allocated += Allocations.load() - allocations;
+            }
+
+            report(name, rules, iterations, ops, bytes, static_cast<double>(elapsed), static_cast<double>(allocated));
+        }
+
+        const Options& options() const noexcept { return m_options; }
+        std::size_t sink() const noexcept { return m_sink; }
+
+    private:
+
+        void report(const std::string& name, int rules, qint64 iterations, std::size_t ops, qint64 bytes, double elapsed, double allocated)
+        {
+            const double calls = static_cast<double>(iterations);
+            const double count = calls * static_cast<double>(std::max<std::size_t>(ops, 1));
+
+            std::cout << (m_first ? "[\n" : ",\n") << "  { \"benchmark\": \"" << name << "\", \"rules\": " << rules
+                      << ", \"iterations\": " << iterations << ", \"ns_per_op\": " << elapsed / count
+                      << ", \"mb_per_s\": " << (bytes > 0 ? bytes * calls / (elapsed / 1e9) / (1024.0 * 1024.0) : 0.0)
+                      << ", \"" << AllocationMetric << "\": " << allocated / count << " }";
+            std::cerr << name << " (" << rules << " rules): " << elapsed / count << " ns/op" << std::endl;
+            m_first = false;
+        }
+
+        Options     m_options;
+        bool        m_first = true;
+        std::size_t m_sink = 0;
+    };
+
+    void RunSheet(Suite& suite, int rules)
+    {
+        const auto sheet = Corpus{}.sheet(rules);
+        const auto utf8 = sheet.toUtf8();
+        const auto bytes = utf8.size();
+        const qss::Document document{ sheet };
+        const auto fragments = document.totalFragments();
+
+        QStringList fragmentTexts;
+        QStringList selectors;
+
+        for (const auto& pair : document)
+        {
+            fragmentTexts.append(pair.first.toString());
+            selectors.append(pair.first.selector().toString());
+        }
+
+        if (rules <= 1000)
+        {
+            suite.run("legacy_regex_split", rules, fragments, bytes, [&sheet]() { return LegacySplit(sheet); });
+        }
+
+        suite.run("lexer", rules, fragments, bytes, [&sheet]() {
+            qss::Lexer lexer;
+            lexer.feed(sheet);
+            lexer.finish();
+            return lexer.tokens().size();
+        });
+
+        suite.run("document_construct", rules, fragments, bytes, [&sheet]() { return qss::Document{ sheet }.totalFragments(); });
+        suite.run("document_construct_arena", rules, fragments, bytes, [&sheet]() {
+            auto parsed = qss::Document::withArena();
+            parsed.parse(sheet);
+            return parsed.totalFragments();
+        });
+
+        // Destruction alone; the arena releases its chunks instead of every node
+        auto destroy = [](qss::Document& parsed) {
+            const auto total = parsed.totalFragments();
+            qss::Document{ std::move(parsed) };
+            return total;
+        };
+        suite.run("document_teardown", rules, fragments, 0, [&sheet]() { return qss::Document{ sheet }; }, destroy);
+        suite.run("document_teardown_arena", rules, fragments, 0, [&sheet]() {
+            auto parsed = qss::Document::withArena();
+            parsed.parse(sheet);
+            return parsed;
+        }, destroy);
+        suite.run("document_from_utf8", rules, fragments, bytes, [&utf8]() { return qss::Document::fromUtf8(utf8).totalFragments(); });
+        suite.run("document_view", rules, fragments, bytes, [&sheet]() { return qss::DocumentView{ sheet }.totalFragments(); });
+
+        // Dropping the colon after "color" leaves every such declaration malformed
+        auto broken = sheet;
+        broken.replace("color:", "color ");
+
+        suite.run("document_diagnostics_clean", rules, fragments, bytes, [&sheet]() {
+            qss::Diagnostics diagnostics;
+            qss::Document parsed;
+            parsed.parse(sheet, diagnostics);
+            return parsed.totalFragments();
+        });
+        suite.run("document_diagnostics_broken", rules, fragments, bytes, [&broken]() {
+            qss::Diagnostics diagnostics;
+            qss::Document parsed;
+            parsed.parse(broken, diagnostics);
+            return parsed.totalFragments() + diagnostics.size();
+        });
+
+        // One run per thread count, doubling from 1 up to the ideal count,
+        // so scaling shows against the single threaded run of the same path
+        if (rules >= 10000)
+        {
+            const auto ideal = std::max(1, QThread::idealThreadCount());
+
+            for (auto threads = 1; threads <= ideal; threads = threads < ideal && threads * 2 > ideal ? ideal : threads * 2)
+            {
+                QThreadPool pool;
+                pool.setMaxThreadCount(threads);
+                suite.run("document_parse_parallel_t" + std::to_string(threads), rules, fragments, bytes, [&sheet, &pool]() {
+                    qss::Document parsed;
+                    parsed.parse(sheet, &pool);
+                    return parsed.totalFragments();
+                });
+            }
+        }
+
+        suite.run("fragment_parse", rules, fragments, bytes, [&fragmentTexts]() {
+            std::size_t total = 0;
+
+            for (const auto& text : fragmentTexts)
+            {
+                total += qss::Fragment{ text }.block().size();
+            }
+
+            return total;
+        });
+
+        suite.run("selector_parse", rules, fragments, 0, [&selectors]() {
+            std::size_t total = 0;
+
+            for (const auto& text : selectors)
+            {
+                total += qss::Selector{ text }.fragmentCount();
+            }
+
+            return total;
+        });
+
+        suite.run("to_string_pretty", rules, fragments, bytes, [&document]() { return static_cast<std::size_t>(document.toString().size()); });
+        suite.run("to_string_minified", rules, fragments, bytes, [&document]() {
+            return static_cast<std::size_t>(qss::Writer::toString(document, qss::Writer::MINIFIED).size());
+        });
+
+        // Adding every fragment twice makes the second half merge
+        suite.run("add_fragment_merge", rules, 2 * fragments, 0, [&document]() {
+            qss::Document merged;
+
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                for (const auto& pair : document)
+                {
+                    merged.addFragment(pair.first);
+                }
+            }
+
+            return merged.totalFragments();
+        });
+
+        const auto samples = std::min<qsizetype>(selectors.size(), 100);
+        suite.run("inheritable", rules, static_cast<std::size_t>(samples), 0, [&document, &selectors, samples]() {
+            std::size_t total = 0;
+
+            for (qsizetype i = 0; i < samples; ++i)
+            {
+                const auto& selector = selectors[i * selectors.size() / samples];
+                total += document.inheritable(selector.mid(selector.lastIndexOf(' ') + 1)).totalFragments();
+            }
+
+            return total;
+        });
+
+        const auto compiled = qss::CompiledDocument::compile(document);
+        suite.run("compiled_load", rules, fragments, compiled.size(), [&compiled]() { return qss::CompiledDocument{ compiled }.totalFragments(); });
+        suite.run("compiled_to_document", rules, fragments, compiled.size(), [&compiled]() {
+            return qss::CompiledDocument{ compiled }.toDocument().totalFragments();
+        });
+
+        // The mmap path: open, map and validate the file, as an application
+        // loads a stylesheet compiled at build time
+        const auto path = QDir::tempPath() + "/bench_qss.qssb";
+        qss::CompiledDocument::save(document, path);
+        suite.run("compiled_from_file", rules, fragments, compiled.size(), [&path]() {
+            return qss::CompiledDocument::fromFile(path).totalFragments();
+        });
+        QFile::remove(path);
+
+        // Versioning by copying the document, against committing a snapshot
+        // that shares everything but the replaced fragment
+        const auto& replacement = document[static_cast<int>(fragments / 2)];
+        suite.run("document_copy_edit", rules, 1, 0, [&document, &replacement, fragments]() {
+            auto copy = document;
+            copy.begin()[static_cast<std::ptrdiff_t>(fragments / 2)].first = replacement;
+            return copy.totalFragments();
+        });
+
+        qss::SharedDocument shared{ qss::Snapshot{ document } };
+        suite.run("snapshot_commit", rules, 1, 0, [&shared, &replacement, fragments]() {
+            return shared.update([&replacement, fragments](const qss::Snapshot& current) {
+                return current.withFragment(fragments / 2, replacement);
+            }).totalFragments();
+        });
+        suite.run("snapshot_take", rules, 1, 0, [&shared]() { return shared.snapshot().totalFragments(); });
+        suite.run("snapshot_read", rules, 1, 0, [&shared]() {
+            return shared.read([](const qss::Snapshot& current) { return current.totalFragments(); });
+        });
+
+        const auto selector = replacement.selector().toString();
+        suite.run("snapshot_find", rules, 1, 0, [&shared, &selector]() {
+            return shared.read([&selector](const qss::Snapshot& current) { return current.find(selector).size(); });
+        });
+    }
+}
+
+namespace
+{
+    // Loads one stylesheet with the instrumentation on, then prints its
+    // Chrome trace on stdout and the totals per phase on stderr. The library
+    // must be built with QSS_INSTRUMENT, otherwise everything reads zero.
+    int Profile(const QString& path)
+    {
+        qss::Instrument::setAllocationCounter([]() { return Allocations.load(std::memory_order_relaxed); });
+        qss::Instrument::reset();
+        qss::Instrument::enable();
+        qss::Instrument::startTrace();
+
+        const auto document = qss::Document::fromFile(path);
+        const auto text = document.toString();
+
+        qss::Instrument::stopTrace();
+        qss::Instrument::enable(false);
+
+        for (int i = 0; i < qss::Instrument::PHASE_COUNT; ++i)
+        {
+            const auto phase = static_cast<qss::Instrument::Phase>(i);
+            const auto stats = qss::Instrument::phase(phase);
+            std::cerr << qss::Instrument::name(phase) << ": " << stats.calls << " calls, " <<
+                static_cast<double>(stats.nanoseconds) / 1e6 << " ms, " << stats.allocations << " allocations" << std::endl;
+        }
+
+        for (int i = 0; i < qss::Instrument::COUNTER_COUNT; ++i)
+        {
+            const auto counter = static_cast<qss::Instrument::Counter>(i);
+            std::cerr << qss::Instrument::name(counter) << ": " << qss::Instrument::counter(counter) << std::endl;
+        }
+
+        const auto trace = qss::Instrument::traceEvents();
+        std::cout.write(trace.constData(), trace.size());
+        return text.isEmpty() && document.totalFragments() > 0 ? 1 : 0;
+    }
+}
+
+// Usage: bench_qss [--max-rules N] [--seconds S] [--filter NAME]
+//        bench_qss --profile FILE
+// Prints a JSON array of results on stdout and a summary on stderr.
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    Options options;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string option = argv[i];
+
+        if (option == "--max-rules")
+        {
+            options.maxRules = std::atoi(argv[i + 1]);
+        }
+        else if (option == "--seconds")
+        {
+            options.seconds = std::atof(argv[i + 1]);
+        }
+        else if (option == "--filter")
+        {
+            options.filter = argv[i + 1];
+        }
+        else if (option == "--profile")
+        {
+            options.profile = QString::fromLocal8Bit(argv[i + 1]);
+        }
+    }
+
+    if (!options.profile.isEmpty())
+    {
+        return Profile(options.profile);
+    }
+
+    std::size_t sink = 0;
+    {
+        Suite suite{ options };
+
+        for (int rules : { 100, 1000, 10000, 100000 })
+        {
+            if (rules <= options.maxRules)
+            {
+                RunSheet(suite, rules);
+            }
+        }
+
+        sink = suite.sink();
+    }
+
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,78 @@
+#ifndef QSSATOM_H
+#define QSSATOM_H
+
+#include "qssproperty.h"
+
+#include <optional>
+
+namespace qss
+{
+    // An interned string. Equal strings share one process wide entry, so
+    // atoms compare and hash as pointers and repeated names such as property
+    // keys or selector types are stored once. Entries are never released.
+    // Interning takes a lock on the table and is safe from any thread. The
+    // known property names are interned first, in Property order, so the
+    // atom of a known property maps back to its id without hashing.
+    class QSS_API Atom
+    {
+    public:
+
+        Atom() noexcept;
+        Atom(const QString& str);
+        Atom(const char* str) : Atom{ QString{ str } } {}
+        explicit Atom(Property property) noexcept;
+
+        const QString& toString() const noexcept { return m_entry->string; }
+        operator const QString&() const noexcept { return m_entry->string; }
+
+        bool        isEmpty() const noexcept { return m_entry->string.isEmpty(); }
+        std::size_t hash() const noexcept { return m_entry->hash; }
+        quint32     id() const noexcept { return m_entry->id; }
+
+        Property property() const noexcept
+        {
+            return m_entry->id >= 1 && m_entry->id <= QSS_PROPERTY_COUNT ? static_cast<Property>(m_entry->id - 1) : QSS_PROPERTY_UNKNOWN;
+        }
+
+        // Returns the atom of an already interned string without adding it
+        static std::optional<Atom> find(const QString& str);
+        static std::size_t count();
+
+        friend bool operator==(Atom lhs, Atom rhs) noexcept { return lhs.m_entry == rhs.m_entry; }
+        friend bool operator!=(Atom lhs, Atom rhs) noexcept { return lhs.m_entry != rhs.m_entry; }
+        friend bool operator==(Atom lhs, const QString& rhs) { return lhs.m_entry->string == rhs; }
+        friend bool operator!=(Atom lhs, const QString& rhs) { return lhs.m_entry->string != rhs; }
+        friend bool operator==(const QString& lhs, Atom rhs) { return lhs == rhs.m_entry->string; }
+        friend bool operator!=(const QString& lhs, Atom rhs) { return lhs != rhs.m_entry->string; }
+        friend bool operator==(Atom lhs, const char* rhs) { return lhs.m_entry->string == rhs; }
+        friend bool operator!=(Atom lhs, const char* rhs) { return lhs.m_entry->string != rhs; }
+
+        struct Entry
+        {
+            QString     string;
+            std::size_t hash;
+            quint32     id;
+        };
+
+    private:
+
+        explicit Atom(const Entry* entry) noexcept : m_entry{ entry } {}
+
+        const Entry* m_entry;
+    };
+
+    struct AtomHasher
+    {
+        std::size_t operator()(Atom atom) const noexcept
+        {
+            return atom.hash();
+        }
+    };
+
+    using AtomList = std::pmr::vector<Atom>;
+    using AtomMap = std::pmr::unordered_map<Atom, QString, AtomHasher>;
+
+    QSS_API std::ostream& operator<<(std::ostream& stream, Atom atom);
+}
+
+#endif // QSSATOM_H
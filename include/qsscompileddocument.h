@@ -0,0 +1,170 @@
+#ifndef QSSCOMPILEDDOCUMENT_H
+#define QSSCOMPILEDDOCUMENT_H
+
+#include "qssdocumentview.h"
+
+#include <memory>
+
+namespace qss
+{
+    class CompiledDocument;
+
+    class QSS_API CompiledElement
+    {
+    public:
+
+        SelectorElement::PositionType position() const noexcept;
+        QStringView name() const;
+        QStringView id() const;
+        QStringView subControl() const;
+        QStringView psuedoClass() const;
+
+        std::size_t classCount() const noexcept;
+        std::size_t paramCount() const noexcept;
+        QStringView className(std::size_t index) const;
+        PropertyView param(std::size_t index) const;
+
+        SelectorElement toElement() const;
+
+    private:
+
+        friend class CompiledFragment;
+
+        CompiledElement(const CompiledDocument* document, std::size_t index) : m_document{ document }, m_index{ index } {}
+
+        const CompiledDocument* m_document;
+        std::size_t             m_index;
+    };
+
+    class QSS_API CompiledFragment
+    {
+    public:
+
+        typedef ViewIterator<CompiledFragment, PropertyView> ConstItr;
+
+        bool isEnabled() const noexcept;
+        std::size_t elementCount() const noexcept;
+        CompiledElement element(std::size_t index) const;
+
+        PropertyView operator[](std::size_t index) const;
+        bool isEnabled(std::size_t index) const noexcept;
+        std::size_t size() const noexcept;
+        QStringView value(QStringView key) const;
+
+        ConstItr begin() const { return ConstItr{ this, 0 }; }
+        ConstItr end() const { return ConstItr{ this, size() }; }
+
+        Fragment toFragment() const;
+
+    private:
+
+        friend class CompiledDocument;
+
+        CompiledFragment(const CompiledDocument* document, std::size_t index) : m_document{ document }, m_index{ index } {}
+
+        const CompiledDocument* m_document;
+        std::size_t             m_index;
+    };
+
+    // A parsed Document stored as flat records: a header, then the fragment,
+    // selector element, property and reference tables, then a string table
+    // whose UTF-16 characters come last. Every field is a native endian
+    // 32 bit integer and strings are referred to by index, so a loaded file
+    // is used where it lies: fromFile() maps it, validates the records once
+    // and hands out views whose strings point into the mapping. Nothing is
+    // allocated until toDocument() or toFragment() rebuilds the mutable
+    // model. Files are tied to the byte order of the machine that wrote them
+    // and are rejected otherwise, as are other versions of the format.
+    class QSS_API CompiledDocument
+    {
+    public:
+
+        typedef ViewIterator<CompiledDocument, CompiledFragment> ConstItr;
+
+        static constexpr quint32 Magic = 0x42535351;   // "QSSB" when little endian
+        static constexpr quint32 Version = 1;
+
+        CompiledDocument() {}
+        CompiledDocument(const QByteArray& data);
+
+        static CompiledDocument fromFile(const QString& path);
+        static QByteArray compile(const Document& document);
+        static void save(const Document& document, const QString& path);
+
+        CompiledFragment operator[](std::size_t index) const { return CompiledFragment{ this, index }; }
+        std::size_t totalFragments() const noexcept { return m_header != nullptr ? m_header->fragments : 0; }
+        std::size_t totalProperties() const noexcept { return m_header != nullptr ? m_header->properties : 0; }
+
+        ConstItr begin() const { return ConstItr{ this, 0 }; }
+        ConstItr end() const { return ConstItr{ this, totalFragments() }; }
+
+        Document toDocument() const;
+
+    private:
+
+        friend class CompiledFragment;
+        friend class CompiledElement;
+
+        struct Header
+        {
+            quint32 magic;
+            quint32 version;
+            quint32 fragments;
+            quint32 elements;
+            quint32 properties;
+            quint32 references;
+            quint32 strings;
+            quint32 characters;
+        };
+
+        struct FragmentRecord
+        {
+            quint32 firstElement;
+            quint32 elementCount;
+            quint32 firstProperty;
+            quint32 propertyCount;
+            quint32 enabled;
+        };
+
+        // Classes are classCount string references starting at firstReference,
+        // followed by paramCount key and value pairs
+        struct ElementRecord
+        {
+            quint32 position;
+            quint32 name;
+            quint32 id;
+            quint32 subControl;
+            quint32 psuedoClass;
+            quint32 firstReference;
+            quint32 classCount;
+            quint32 paramCount;
+        };
+
+        struct PropertyRecord
+        {
+            quint32 key;
+            quint32 value;
+            quint32 enabled;
+        };
+
+        struct StringRecord
+        {
+            quint32 offset;
+            quint32 length;
+        };
+
+        void load(const uchar* data, qsizetype size);
+        QStringView string(quint32 index) const { return QStringView{ m_characters + m_strings[index].offset, m_strings[index].length }; }
+
+        std::shared_ptr<const void> m_owner;    // the mapped file or the bytes
+        const Header*               m_header = nullptr;
+        const FragmentRecord*       m_fragments = nullptr;
+        const ElementRecord*        m_elements = nullptr;
+        const PropertyRecord*       m_properties = nullptr;
+        const quint32*              m_references = nullptr;
+        const StringRecord*         m_strings = nullptr;
+        const char16_t*             m_characters = nullptr;
+    };
+}
+
+#endif // QSSCOMPILEDDOCUMENT_H
@@ -3,61 +3,218 @@
 
 #include "qssfragment.h"
 
+#include <QFile>
+#include <QThreadPool>
+
 #include <algorithm>
+#include <memory>
 
 namespace qss
 {
+    // Fragments are indexed by selector, so addFragment merges into an
+    // existing selector in constant time and lookups by selector do not scan.
+    // Every mutating method keeps the index current, so const lookups only
+    // read it and may run concurrently. Taking a mutable iterator or
+    // reference drops it, since the selector may be edited through it;
+    // lookups then scan, comparing the hashes every edit keeps current, until
+    // reindex() or the next mutating method rebuilds it.
+    //
+    // A document parsed from a single QString keeps that text and where each
+    // fragment ends in it, so edit() can re-lex and re-parse only the
+    // fragments a text edit touches. Any other change to the fragment list
+    // drops the source and edit() throws until the next parse.
+    //
+    // The overloads taking Diagnostics never throw on malformed input: bad
+    // declarations and fragments are skipped and appended to the list, in
+    // input order with line and column filled in, and everything else is
+    // kept. Such a parse does not keep its source for edit().
+    //
+    // Fragments, and the containers inside their selectors and blocks, are
+    // allocated from the document's memory resource. withArena() gives a
+    // document its own monotonic arena: parsing appends to it without
+    // freeing, and destroying the document, or moving another one into it,
+    // releases the arena's few chunks at once. Copies use the default
+    // resource. QString data is allocated by Qt and stays outside the arena.
+    // The arena is not thread safe, so a parallel parse builds fragments on
+    // the heap and copies them in. Best for documents parsed once and then
+    // read, since edits keep growing the arena.
     class QSS_API Document : public IParseable
     {
     public:
 
         typedef InvalidablePair<Fragment> QSSFragmentPair;
-        typedef typename std::deque<QSSFragmentPair>::const_iterator ConstItr;
-        typedef typename std::deque<QSSFragmentPair>::iterator Itr;
+        typedef typename std::pmr::deque<QSSFragmentPair>::const_iterator ConstItr;
+        typedef typename std::pmr::deque<QSSFragmentPair>::iterator Itr;
+
+        static constexpr std::size_t ArenaSize = 64 * 1024;    // first chunk of withArena()
+
+        // Fragments [first, first + removed) were replaced by [first, first + inserted)
+        struct FragmentRange
+        {
+            std::size_t first = 0;
+            std::size_t removed = 0;
+            std::size_t inserted = 0;
+        };
 
         Document() {}
+        explicit Document(std::pmr::memory_resource* resource) : m_fragments{ Allocator{ resource } } {}
         Document(const QString& qss);
+        Document(const Document& document);
+        Document(Document&& document);
         virtual ~Document() {}
 
+        Document& operator=(const Document& document);
+        Document& operator=(Document&& document);
+
+        static Document withArena(std::size_t initialSize = ArenaSize);
+        std::pmr::memory_resource* resource() const { return m_fragments.get_allocator().resource(); }
+
+        static Document fromFile(const QString& path);
+        static Document fromUtf8(QByteArrayView utf8);
+        static Document fromFile(const QString& path, Diagnostics& diagnostics);
+        static Document fromUtf8(QByteArrayView utf8, Diagnostics& diagnostics);
+
         Document& addFragment(const Fragment& fragment, bool enabled = true);
+        Document& addFragment(Fragment&& fragment, bool enabled = true);
         Document& addFragment(const QString& fragment, bool enabled = true);
+
+        // Constructs an enabled fragment in place from args, e.g. a selector
+        // and a block to move in, then merges it like addFragment
+        template <typename... Args>
+        Document& emplaceFragment(Args&&... args);
+
         Document& enableFragment(int index, bool enable = true);
         Document& toggleFragment(int index);
         Document& removeFragment(const QString& fragment);
         Document& removeFragment(int index);
+        Document& removeFragments(const QStringList& selectors);
+        template <typename Predicate>
+        Document& removeIf(Predicate predicate);
         Document& operator+=(const QString& fragment);
         Document& operator+=(const Document& qss);
+        Document& operator+=(Document&& qss);
 
         Document inheritable(const QString& selector) const;
+        std::vector<std::size_t> find(const QString& selector) const;
+        QString value(const QString& selector, const QString& key) const;
+        void reindex();
+
+        FragmentRange edit(qsizetype position, qsizetype removed, const QString& inserted);
+        bool isEditable() const noexcept { return m_editable; }
+        const QString& source() const noexcept { return m_source; }
 
         void parse(const QString&);
+        void parse(const Lexer& lexer);
+        void parse(const Utf8Lexer& lexer);
+        void parse(const QString& input, QThreadPool* pool);
+        void parse(const Lexer& lexer, QThreadPool* pool);
+        void parse(const QString& input, Diagnostics& diagnostics);
         QString toString() const;
 
         const Fragment& operator[](int index) const { return m_fragments[index].first; }
         std::size_t totalFragments() const noexcept { return m_fragments.size(); }
         std::size_t totalActiveFragments() const;
+        bool isEnabled(int index) const { return m_fragments[index].second; }
+
+        // Bumped by every mutating method above; blocks track their own edits
+        quint64 generation() const noexcept { return m_generation; }
 
         ConstItr cbegin() const noexcept { return m_fragments.cbegin(); }
         ConstItr cend() const noexcept { return m_fragments.cend(); }
         ConstItr begin() const noexcept { return m_fragments.cbegin(); }
         ConstItr end() const noexcept { return m_fragments.cend(); }
-        Itr      begin() noexcept { return m_fragments.begin(); }
-        Itr      end() noexcept { return m_fragments.end(); }
+        Itr      begin() noexcept { m_indexed = false; return m_fragments.begin(); }
+        Itr      end() noexcept { m_indexed = false; return m_fragments.end(); }
 
         const Fragment& front() const noexcept { return m_fragments.front().first; }
         const Fragment& back() const noexcept { return m_fragments.back().first; }
 
-        Fragment& front() noexcept { return m_fragments.front().first; }
-        Fragment& back() noexcept { return m_fragments.back().first; }
+        Fragment& front() noexcept { m_indexed = false; return m_fragments.front().first; }
+        Fragment& back() noexcept { m_indexed = false; return m_fragments.back().first; }
 
         friend Document operator+(const Document& lhs, const Document& rhs);
+        friend class CompiledDocument;
+        friend class StaticDocumentBase;
+        friend class Snapshot;
 
     private:
 
-        std::deque<QSSFragmentPair> m_fragments;
+        // Selector hash to the positions of the fragments with that hash
+        typedef std::unordered_map<quint64, std::vector<std::size_t>> SelectorIndex;
+
+        // The length of source each fragment spans, up to its end from the
+        // end of the one before, summed in a Fenwick tree. An edit changes
+        // the lengths of the fragments it re-parses only, so later ends move
+        // without being touched, and finding an end takes O(log n).
+        class Ends
+        {
+        public:
+
+            void assign(std::vector<qsizetype>&& lengths);
+            void replace(std::size_t first, std::size_t last, const std::vector<qsizetype>& lengths);
+            void clear() noexcept { m_lengths.clear(); m_tree.clear(); }
+
+            std::size_t size() const noexcept { return m_lengths.size(); }
+            qsizetype end(std::size_t index) const;
+            std::size_t upperBound(qsizetype position) const;
+            std::size_t lowerBound(qsizetype position) const;
+
+        private:
+
+            void build();
+            std::size_t search(qsizetype position, bool inclusive) const;
+
+            std::vector<qsizetype> m_lengths;
+            std::vector<qsizetype> m_tree;     // 1-based partial sums of m_lengths
+        };
+
+        SelectorIndex& selectorIndex();
+        void track(const QString& source, const Lexer& lexer);
+        bool merge(const std::vector<std::size_t>& positions, Fragment&& fragment);
+        void mergeLast();
+        template <typename L>
+        void append(const L& lexer, Diagnostics* diagnostics);
+
+        std::shared_ptr<std::pmr::memory_resource> m_arena;    // outlives the fragments allocated from it
+        std::pmr::deque<QSSFragmentPair>           m_fragments;
+        quint64                                    m_generation = nextGeneration();
+        SelectorIndex                              m_index;
+        bool                                       m_indexed = true;   // false after a mutable iterator or reference was taken
+        QString                                    m_source;
+        Ends                                       m_ends;     // where each fragment ends in m_source
+        bool                                       m_editable = false;
     };
 
     Document operator+(const Document& lhs, const Document& rhs);
+    Document operator+(Document&& lhs, const Document& rhs);
+
+    template <typename... Args>
+    Document& Document::emplaceFragment(Args&&... args)
+    {
+        // Indexed first, so the new fragment is not found as its own match
+        selectorIndex();
+        m_fragments.emplace_back(std::piecewise_construct, std::forward_as_tuple(std::forward<Args>(args)...), std::forward_as_tuple(true));
+        mergeLast();
+        return *this;
+    }
+
+    // Removes every fragment pair the predicate accepts in one compacting
+    // pass, keeping the order of the rest
+    template <typename Predicate>
+    Document& Document::removeIf(Predicate predicate)
+    {
+        auto itr = std::remove_if(m_fragments.begin(), m_fragments.end(), predicate);
+
+        if (itr != m_fragments.end())
+        {
+            m_generation = nextGeneration();
+            m_editable = false;
+            m_fragments.erase(itr, m_fragments.end());
+            reindex();
+        }
+
+        return *this;
+    }
 }
 
 #endif // QSSTEXT_H
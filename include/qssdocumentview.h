@@ -0,0 +1,100 @@
+#ifndef QSSDOCUMENTVIEW_H
+#define QSSDOCUMENTVIEW_H
+
+#include "qssdocument.h"
+
+namespace qss
+{
+    // Index based const iterator shared by the view types below
+    template <typename Owner, typename Value>
+    class ViewIterator
+    {
+    public:
+
+        ViewIterator(const Owner* owner, std::size_t index) : m_owner{ owner }, m_index{ index } {}
+
+        Value operator*() const { return (*m_owner)[m_index]; }
+        ViewIterator& operator++() { ++m_index; return *this; }
+        ViewIterator operator++(int) { auto itr = *this; ++m_index; return itr; }
+
+        bool operator==(const ViewIterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const ViewIterator& other) const { return m_index != other.m_index; }
+
+    private:
+
+        const Owner* m_owner;
+        std::size_t  m_index;
+    };
+
+    class QSS_API PropertyView
+    {
+    public:
+
+        PropertyView(QStringView key, QStringView value) : m_key{ key }, m_value{ value } {}
+
+        QStringView key() const noexcept { return m_key; }
+        QStringView value() const noexcept { return m_value; }
+
+    private:
+
+        QStringView m_key;
+        QStringView m_value;
+    };
+
+    class QSS_API FragmentView
+    {
+    public:
+
+        typedef ViewIterator<FragmentView, PropertyView> ConstItr;
+
+        FragmentView(const Lexer* lexer, const Lexer::Token* token) : m_lexer{ lexer }, m_token{ token } {}
+
+        QStringView selector() const { return m_lexer->text(m_token->selector); }
+        QStringView block() const { return m_lexer->text(m_token->block); }
+        QStringView value(QStringView key) const;
+
+        PropertyView operator[](std::size_t index) const;
+        std::size_t size() const noexcept { return static_cast<std::size_t>(m_token->declarationCount); }
+
+        ConstItr begin() const { return ConstItr{ this, 0 }; }
+        ConstItr end() const { return ConstItr{ this, size() }; }
+
+        Fragment toFragment() const;
+
+    private:
+
+        const Lexer*        m_lexer;
+        const Lexer::Token* m_token;
+    };
+
+    // Immutable, read only counterpart of Document. Selectors, keys and values
+    // are slices of the one lexed source buffer the view retains; QStrings are
+    // only created by toDocument() or toFragment() when something is mutated.
+    class QSS_API DocumentView
+    {
+    public:
+
+        typedef ViewIterator<DocumentView, FragmentView> ConstItr;
+
+        DocumentView() {}
+        DocumentView(const QString& qss) { parse(qss); }
+
+        void parse(const QString& qss);
+
+        FragmentView operator[](std::size_t index) const { return FragmentView{ &m_lexer, &m_lexer.tokens()[index] }; }
+        std::size_t totalFragments() const noexcept { return m_lexer.tokens().size(); }
+        std::size_t totalProperties() const noexcept { return m_lexer.declarations().size(); }
+
+        ConstItr begin() const { return ConstItr{ this, 0 }; }
+        ConstItr end() const { return ConstItr{ this, totalFragments() }; }
+
+        const QString& source() const noexcept { return m_lexer.buffer(); }
+        Document toDocument() const;
+
+    private:
+
+        Lexer m_lexer;
+    };
+}
+
+#endif // QSSDOCUMENTVIEW_H
@@ -3,6 +3,8 @@
 
 #include "qssparseable.h"
 
+#include <QByteArrayView>
+
 namespace qss
 {
     class QSS_API Exception
@@ -16,13 +18,22 @@ namespace qss
             SELECTOR_INVALID,
             BLOCK_BRACKETS_INVALID,
             MULTIPLE_IDS,
-            ILL_FORMED_HEADER_PARAM
+            ILL_FORMED_HEADER_PARAM,
+            FILE_UNREADABLE,
+            EDIT_INVALID,
+            FILE_UNWRITABLE,
+            COMPILED_INVALID
         };
 
         Exception(int code, const QString& details = "")
             : m_code{ code }, m_details{ details } {}
 
         QString what() const;
+        int     code() const noexcept { return m_code; }
+
+        // Throws, unless the caller collects errors: then the code is
+        // stored in error and false returned
+        static bool raise(int* error, int code, const QString& details = "");
 
     private:
 
@@ -31,6 +42,23 @@ namespace qss
         int     m_code;
         QString m_details;
     };
+
+    // A problem the error recovering parse skipped over instead of throwing.
+    // offset counts positions in the input as given: UTF-16 units for a
+    // QString, bytes for UTF-8. Line and column are 1-based and filled in by
+    // locate(), which only has to scan the input when something went wrong.
+    struct Diagnostic
+    {
+        int       code = 0;     // one of Exception::Codes
+        qsizetype offset = 0;
+        int       line = 0;
+        int       column = 0;
+    };
+
+    typedef std::vector<Diagnostic> Diagnostics;
+
+    QSS_API void locate(Diagnostics& diagnostics, QStringView input);
+    QSS_API void locate(Diagnostics& diagnostics, QByteArrayView input);
 }
 
 
@@ -10,13 +10,31 @@ namespace qss
     {
     public:
 
+        typedef Allocator allocator_type;
+
         Fragment() {}
+        explicit Fragment(const allocator_type& allocator) : m_selector{ allocator }, m_block{ allocator } {}
+        Fragment(const Fragment& fragment) : Fragment{ fragment, allocator_type{} } {}
+        Fragment(const Fragment& fragment, const allocator_type& allocator)
+            : m_selector{ fragment.m_selector, allocator }, m_block{ fragment.m_block, allocator } {}
+        Fragment(Fragment&& fragment) : m_selector{ std::move(fragment.m_selector) }, m_block{ std::move(fragment.m_block) } {}
+        Fragment(Fragment&& fragment, const allocator_type& allocator)
+            : m_selector{ std::move(fragment.m_selector), allocator }, m_block{ std::move(fragment.m_block), allocator } {}
         Fragment(const QString& str);
+        Fragment(const QString& str, const allocator_type& allocator);
+        Fragment(Selector&& selector, PropertyBlock&& block) : m_selector{ std::move(selector) }, m_block{ std::move(block) } {}
+        Fragment(Selector&& selector, PropertyBlock&& block, const allocator_type& allocator)
+            : m_selector{ std::move(selector), allocator }, m_block{ std::move(block), allocator } {}
         Fragment& operator=(const Fragment& fragment);
+        Fragment& operator=(Fragment&& fragment);
+
+        allocator_type get_allocator() const { return m_block.get_allocator(); }
 
         Fragment& select(const Selector& selector);
+        Fragment& select(Selector&& selector);
         Fragment& select(const QString& selector);
         Fragment& addBlock(const PropertyBlock& block);
+        Fragment& addBlock(PropertyBlock&& block);
         Fragment& addBlock(const QString& block);
         Fragment& addBlock(const QStringPairs& block);
         Fragment& addParam(const QStringPair& param);
@@ -32,7 +50,12 @@ namespace qss
         PropertyBlock& block() noexcept { return m_block; }
 
         void    parse(const QString& input);
+        void    parse(const Lexer& lexer, const Lexer::Token& token);
+        void    parse(const Utf8Lexer& lexer, const Lexer::Token& token);
+        bool    parse(const Lexer& lexer, const Lexer::Token& token, int& error);
+        bool    parse(const Utf8Lexer& lexer, const Lexer::Token& token, int& error);
         QString toString() const;
+        quint64 hash() const noexcept { return hashCombine(m_selector.hash(), m_block.hash()); }
 
         friend bool operator==(const Fragment& lhs, const Fragment& rhs);
 
@@ -43,6 +66,8 @@ namespace qss
     };
 
     bool operator==(const Fragment& lhs, const Fragment& rhs);
+    inline bool operator!=(const Fragment& lhs, const Fragment& rhs) { return !(lhs == rhs); }
+    inline std::size_t qHash(const Fragment& fragment, std::size_t seed = 0) noexcept { return static_cast<std::size_t>(hashCombine(seed, fragment.hash())); }
 }
 
 #endif // QSSFRAGMENT_H
@@ -0,0 +1,103 @@
+#ifndef QSSINSTRUMENT_H
+#define QSSINSTRUMENT_H
+
+#include "qssutils.h"
+
+#include <QByteArray>
+
+namespace qss
+{
+    // Where parsing and serializing spend their time. The library is
+    // instrumented through QSS_SCOPE and QSS_COUNT, which expand to nothing
+    // unless it is built with QSS_INSTRUMENT defined; this class is always
+    // present and reports zeros otherwise. Even when built in, nothing is
+    // recorded until enable(true), and a disabled scope costs one relaxed
+    // load. Totals are atomic, so parses on several threads add up. Only the
+    // outermost scope of a phase on a thread is timed, so a recursive write
+    // is counted once.
+    //
+    // The lexer strips comments and splits fragments in a single pass, so
+    // both are timed as LEX. Allocations are not counted by the library
+    // itself: an application that replaces operator new can pass its
+    // running total to setAllocationCounter() and each phase is charged the
+    // difference.
+    class QSS_API Instrument
+    {
+    public:
+
+        enum Phase
+        {
+            LEX,
+            SELECTOR_PARSE,
+            BLOCK_PARSE,
+            SERIALIZE,
+            PHASE_COUNT
+        };
+
+        enum Counter
+        {
+            FRAGMENTS,
+            PROPERTIES,
+            BYTES,      // input lexed, in bytes of its encoding
+            COUNTER_COUNT
+        };
+
+        struct PhaseStats
+        {
+            quint64 calls = 0;
+            quint64 nanoseconds = 0;
+            quint64 allocations = 0;
+        };
+
+        class QSS_API Scope
+        {
+        public:
+
+            explicit Scope(Phase phase);
+            ~Scope();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+
+            Phase   m_phase;
+            bool    m_entered = false;  // recording was on when the scope began
+            bool    m_active = false;   // outermost scope of its phase, so timed
+            quint64 m_start = 0;
+            quint64 m_allocations = 0;
+        };
+
+        static void enable(bool enable = true);
+        static bool isEnabled() noexcept;
+        static void reset();
+
+        // Trace events are kept, up to maxEvents, only while tracing
+        static void startTrace(std::size_t maxEvents = 1 << 20);
+        static void stopTrace();
+
+        static void setAllocationCounter(quint64 (*counter)());
+
+        static void count(Counter counter, quint64 amount);
+        static PhaseStats phase(Phase phase);
+        static quint64 counter(Counter counter);
+        static const char* name(Phase phase) noexcept;
+        static const char* name(Counter counter) noexcept;
+
+        // The recorded scopes as Chrome trace-event JSON, loadable by
+        // chrome://tracing or Perfetto, with the counters as a final sample
+        static QByteArray traceEvents();
+    };
+}
+
+#ifdef QSS_INSTRUMENT
+#define QSS_SCOPE_NAME(line) qssScope##line
+#define QSS_SCOPE_AT(id, line) ::qss::Instrument::Scope QSS_SCOPE_NAME(line){ ::qss::Instrument::id }
+#define QSS_SCOPE(id) QSS_SCOPE_AT(id, __LINE__)
+#define QSS_COUNT(id, amount) ::qss::Instrument::count(::qss::Instrument::id, static_cast<quint64>(amount))
+#else
+#define QSS_SCOPE(id)
+#define QSS_COUNT(id, amount)
+#endif
+
+#endif // QSSINSTRUMENT_H
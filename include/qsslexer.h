@@ -0,0 +1,153 @@
+#ifndef QSSLEXER_H
+#define QSSLEXER_H
+
+#include "qssexception.h"
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+namespace qss
+{
+    template <typename Char> struct LexerTraits;
+
+    template <> struct LexerTraits<QChar>
+    {
+        typedef QString     Buffer;
+        typedef QStringView View;
+
+        static char16_t unit(QChar c) noexcept { return c.unicode(); }
+        static bool     isSpace(QChar c) noexcept { return c.isSpace(); }
+        static QString  toString(const QChar* data, qsizetype size) { return QString{ data, size }.replace(QChar('\n'), QChar(' ')); }
+    };
+
+    // UTF-8 is lexed byte by byte: every delimiter is ASCII and never occurs
+    // inside a multi-byte sequence, so only the final slices are decoded
+    template <> struct LexerTraits<char>
+    {
+        typedef QByteArray     Buffer;
+        typedef QByteArrayView View;
+
+        static char16_t unit(char c) noexcept { return static_cast<unsigned char>(c); }
+        static bool     isSpace(char c) noexcept { return c == ' ' || (c >= '\t' && c <= '\r'); }
+        static QString  toString(const char* data, qsizetype size) { return QString::fromUtf8(data, size).replace(QChar('\n'), QChar(' ')); }
+    };
+
+    class QSS_API LexerBase
+    {
+    public:
+
+        enum Context
+        {
+            DOCUMENT,   // input is a sequence of "selector { block }" fragments
+            BLOCK       // input is the body of a single block, without brackets
+        };
+
+        struct Span
+        {
+            qsizetype begin = 0;
+            qsizetype length = 0;
+        };
+
+        struct Declaration
+        {
+            Span key;
+            Span value;
+        };
+
+        struct Token
+        {
+            Span      selector;
+            Span      block;
+            Span      source;   // input consumed, from the previous fragment's '}' through this one's
+            qsizetype firstDeclaration = 0;
+            qsizetype declarationCount = 0;
+        };
+    };
+
+    // Single pass tokenizer for QSS text. Comments are stripped in place,
+    // quoted strings and escapes are skipped over, and every top level
+    // "selector { key: value; ... }" fragment is reported as spans into the
+    // cleaned buffer, so no intermediate strings are built while lexing.
+    // Line breaks are left in the buffer and become spaces in string().
+    // Token::source spans count positions in the input as fed, comments
+    // included, so they stay valid against the original text.
+    // The buffer is either owned (feed) or caller provided writable memory (lex).
+    // Malformed input throws, unless a Diagnostics list is given: then the
+    // problem is recorded and skipped the way CSS does. A declaration without
+    // ':' or holding a nested block is dropped, the nested block up to its
+    // closing bracket, and a stray '}' is ignored with the selector text
+    // before it.
+    template <typename Char>
+    class BasicLexer : public LexerBase
+    {
+    public:
+
+        typedef LexerTraits<Char>         Traits;
+        typedef typename Traits::Buffer   Buffer;
+        typedef typename Traits::View     View;
+
+        BasicLexer(Context context = DOCUMENT, Diagnostics* diagnostics = nullptr) : m_diagnostics{ diagnostics } { reset(context); }
+
+        void reset(Context context = DOCUMENT);
+        void feed(const Buffer& input);
+        void feed(View input);
+        void lex(Char* data, qsizetype size);
+        void finish();
+        void discardTokens();
+
+        View    text(const Span& span) const { return View{ m_data + span.begin, span.length }; }
+        QString string(const Span& span) const { return Traits::toString(m_data + span.begin, span.length); }
+        View    cleaned() const { return View{ m_data, m_write }; }
+        const Buffer& buffer() const noexcept { return m_buffer; }
+
+        const std::vector<Token>& tokens() const noexcept { return m_tokens; }
+        const std::vector<Declaration>& declarations() const noexcept { return m_declarations; }
+        const Declaration& declaration(const Token& token, qsizetype index) const { return m_declarations[token.firstDeclaration + index]; }
+
+    private:
+
+        enum State
+        {
+            NORMAL, SLASH, STRING, STRING_ESCAPE, ESCAPE, COMMENT, COMMENT_STAR
+        };
+
+        void lex(qsizetype size);
+        void put(qsizetype index, Char c);
+        void openBlock(qsizetype position);
+        void closeBlock();
+        void closeDeclaration();
+        Span trimmed(qsizetype begin, qsizetype end) const;
+
+        Context   m_context = DOCUMENT;
+        State     m_state = NORMAL;
+        char16_t  m_quote = 0;
+        bool      m_inBlock = false;
+        bool      m_external = false;
+        qsizetype m_read = 0;
+        qsizetype m_write = 0;
+        qsizetype m_fragmentStart = 0;
+        qsizetype m_blockStart = 0;
+        qsizetype m_declarationStart = 0;
+        qsizetype m_colon = -1;
+        qsizetype m_firstDeclaration = 0;
+        qsizetype m_source = 0;             // input position of m_read
+        qsizetype m_fragmentSource = 0;     // input position the current fragment starts at
+        qsizetype m_declarationSource = 0;  // input position the current declaration starts at
+        qsizetype m_depth = 0;              // brackets open in a nested block being skipped
+        bool      m_invalid = false;        // the current declaration is dropped
+        Diagnostics* m_diagnostics = nullptr;
+        Char*     m_data = nullptr;
+        Buffer    m_buffer;
+
+        std::vector<Token>       m_tokens;
+        std::vector<Declaration> m_declarations;
+    };
+
+    extern template class QSS_API BasicLexer<QChar>;
+    extern template class QSS_API BasicLexer<char>;
+
+    typedef BasicLexer<QChar> Lexer;
+    typedef BasicLexer<char>  Utf8Lexer;
+}
+
+#endif // QSSLEXER_H
@@ -0,0 +1,110 @@
+#ifndef QSSMATCHER_H
+#define QSSMATCHER_H
+
+#include "qsssnapshot.h"
+
+namespace qss
+{
+    // A widget as seen by selectors. Ancestors and preceding siblings are
+    // linked through pointers owned by the caller. Names stay strings: the
+    // matcher looks them up among the interned atoms when it tests rules,
+    // without interning them, so generated object names never grow the atom
+    // table, and a name no selector uses simply matches nothing.
+    struct QSS_API Element
+    {
+        QString        type;                        // class name, e.g. QPushButton
+        QStringList    inherits;                    // base class names, matched by type selectors
+        QString        id;                          // objectName
+        QStringList    classes;
+        QStringMap     params;                      // dynamic properties, matched by [key="value"]
+        QStringList    states;                      // active pseudo states, e.g. hover, checked
+        QString        subControl;
+        const Element* parent = nullptr;
+        const Element* previousSibling = nullptr;
+    };
+
+    // Answers which fragments of a Document or Snapshot apply to an element.
+    // Every comma separated alternative of a selector is filed in one bucket
+    // keyed on its rightmost element (id, then class, then type, then param
+    // name) so a lookup only tests the rules that could possibly match.
+    // Specificity is computed once per alternative when the rule is filed.
+    //
+    // A document is held by reference and must outlive the matcher, which
+    // indexes it as it was when constructed and must be rebuilt after
+    // fragments are added or removed; enabled flags are read live. A
+    // snapshot is held by copy, O(1), so the matcher keeps its version alive
+    // and, like the snapshot, can be read from any number of threads.
+    class QSS_API Matcher
+    {
+    public:
+
+        explicit Matcher(const Document& document);
+        explicit Matcher(Snapshot snapshot);
+        Matcher(Document&&) = delete;
+
+        std::vector<std::size_t> match(const Element& element) const;
+        PropertyBlock computeStyle(const Element& element, std::vector<std::size_t>* fragments = nullptr) const;
+
+        static bool matches(const SelectorElement& selector, const Element& element);
+
+    private:
+
+        typedef std::unordered_map<Atom, std::vector<std::size_t>, AtomHasher> Buckets;
+
+        // An element's names as atoms, found without interning. Names that
+        // were never interned are left out, as no selector can use them; a
+        // sub-control is the exception, since leaving it out would match
+        // selectors without one.
+        struct Names
+        {
+            explicit Names(const Element& element);
+
+            Atom     type;
+            AtomList inherits;
+            Atom     id;
+            AtomList classes;
+            AtomMap  params;
+            Atom     subControl;
+            bool     unknownSubControl = false;
+        };
+
+        // Each element is looked up once per match, however often rules revisit it
+        typedef std::unordered_map<const Element*, Names> NameCache;
+
+        struct Rule
+        {
+            std::size_t fragment;
+            int         first;
+            int         last;
+            Specificity specificity;
+        };
+
+        typedef std::pair<std::size_t, Specificity> RuleMatch;
+
+        void addRules();
+        std::vector<RuleMatch> matchRules(const Element& element) const;
+        void addRule(const Rule& rule);
+        bool matches(const Rule& rule, int index, const Element& element, NameCache& names) const;
+
+        static bool matches(const SelectorElement& selector, const Element& element, const Names& names);
+        static const Names& lookup(const Element& element, NameCache& names);
+
+        static void collect(const Buckets& buckets, Atom key, std::vector<std::size_t>& candidates);
+
+        // Read from the document when there is one, else from the snapshot
+        std::size_t totalFragments() const;
+        const Fragment& fragment(std::size_t index) const;
+        bool isEnabled(std::size_t index) const;
+
+        const Document*          m_document = nullptr;
+        Snapshot                 m_snapshot;
+        std::vector<Rule>        m_rules;
+        Buckets                  m_ids;
+        Buckets                  m_classes;
+        Buckets                  m_types;
+        Buckets                  m_params;
+        std::vector<std::size_t> m_universal;
+    };
+}
+
+#endif // QSSMATCHER_H
@@ -0,0 +1,234 @@
+#ifndef QSSPROPERTY_H
+#define QSSPROPERTY_H
+
+#include "qssutils.h"
+
+#include <QStringView>
+
+#include <array>
+#include <string_view>
+
+// The properties documented in the Qt Style Sheets reference
+#define QSS_KNOWN_PROPERTIES(X) \
+    X(ALTERNATE_BACKGROUND_COLOR, "alternate-background-color") \
+    X(ACCENT_COLOR, "accent-color") \
+    X(BACKGROUND, "background") \
+    X(BACKGROUND_ATTACHMENT, "background-attachment") \
+    X(BACKGROUND_CLIP, "background-clip") \
+    X(BACKGROUND_COLOR, "background-color") \
+    X(BACKGROUND_IMAGE, "background-image") \
+    X(BACKGROUND_ORIGIN, "background-origin") \
+    X(BACKGROUND_POSITION, "background-position") \
+    X(BACKGROUND_REPEAT, "background-repeat") \
+    X(BORDER, "border") \
+    X(BORDER_BOTTOM, "border-bottom") \
+    X(BORDER_BOTTOM_COLOR, "border-bottom-color") \
+    X(BORDER_BOTTOM_LEFT_RADIUS, "border-bottom-left-radius") \
+    X(BORDER_BOTTOM_RIGHT_RADIUS, "border-bottom-right-radius") \
+    X(BORDER_BOTTOM_STYLE, "border-bottom-style") \
+    X(BORDER_BOTTOM_WIDTH, "border-bottom-width") \
+    X(BORDER_COLOR, "border-color") \
+    X(BORDER_IMAGE, "border-image") \
+    X(BORDER_LEFT, "border-left") \
+    X(BORDER_LEFT_COLOR, "border-left-color") \
+    X(BORDER_LEFT_STYLE, "border-left-style") \
+    X(BORDER_LEFT_WIDTH, "border-left-width") \
+    X(BORDER_RADIUS, "border-radius") \
+    X(BORDER_RIGHT, "border-right") \
+    X(BORDER_RIGHT_COLOR, "border-right-color") \
+    X(BORDER_RIGHT_STYLE, "border-right-style") \
+    X(BORDER_RIGHT_WIDTH, "border-right-width") \
+    X(BORDER_STYLE, "border-style") \
+    X(BORDER_TOP, "border-top") \
+    X(BORDER_TOP_COLOR, "border-top-color") \
+    X(BORDER_TOP_LEFT_RADIUS, "border-top-left-radius") \
+    X(BORDER_TOP_RIGHT_RADIUS, "border-top-right-radius") \
+    X(BORDER_TOP_STYLE, "border-top-style") \
+    X(BORDER_TOP_WIDTH, "border-top-width") \
+    X(BORDER_WIDTH, "border-width") \
+    X(BOTTOM, "bottom") \
+    X(BUTTON_LAYOUT, "button-layout") \
+    X(COLOR, "color") \
+    X(DIALOGBUTTONBOX_BUTTONS_HAVE_ICONS, "dialogbuttonbox-buttons-have-icons") \
+    X(FONT, "font") \
+    X(FONT_FAMILY, "font-family") \
+    X(FONT_SIZE, "font-size") \
+    X(FONT_STYLE, "font-style") \
+    X(FONT_WEIGHT, "font-weight") \
+    X(GRIDLINE_COLOR, "gridline-color") \
+    X(HEIGHT, "height") \
+    X(ICON, "icon") \
+    X(ICON_SIZE, "icon-size") \
+    X(IMAGE, "image") \
+    X(IMAGE_POSITION, "image-position") \
+    X(LEFT, "left") \
+    X(LINEEDIT_PASSWORD_CHARACTER, "lineedit-password-character") \
+    X(LINEEDIT_PASSWORD_MASK_DELAY, "lineedit-password-mask-delay") \
+    X(MARGIN, "margin") \
+    X(MARGIN_BOTTOM, "margin-bottom") \
+    X(MARGIN_LEFT, "margin-left") \
+    X(MARGIN_RIGHT, "margin-right") \
+    X(MARGIN_TOP, "margin-top") \
+    X(MAX_HEIGHT, "max-height") \
+    X(MAX_WIDTH, "max-width") \
+    X(MESSAGEBOX_TEXT_INTERACTION_FLAGS, "messagebox-text-interaction-flags") \
+    X(MIN_HEIGHT, "min-height") \
+    X(MIN_WIDTH, "min-width") \
+    X(OPACITY, "opacity") \
+    X(OUTLINE, "outline") \
+    X(OUTLINE_BOTTOM_LEFT_RADIUS, "outline-bottom-left-radius") \
+    X(OUTLINE_BOTTOM_RIGHT_RADIUS, "outline-bottom-right-radius") \
+    X(OUTLINE_COLOR, "outline-color") \
+    X(OUTLINE_OFFSET, "outline-offset") \
+    X(OUTLINE_RADIUS, "outline-radius") \
+    X(OUTLINE_STYLE, "outline-style") \
+    X(OUTLINE_TOP_LEFT_RADIUS, "outline-top-left-radius") \
+    X(OUTLINE_TOP_RIGHT_RADIUS, "outline-top-right-radius") \
+    X(PADDING, "padding") \
+    X(PADDING_BOTTOM, "padding-bottom") \
+    X(PADDING_LEFT, "padding-left") \
+    X(PADDING_RIGHT, "padding-right") \
+    X(PADDING_TOP, "padding-top") \
+    X(PAINT_ALTERNATING_ROW_COLORS_FOR_EMPTY_AREA, "paint-alternating-row-colors-for-empty-area") \
+    X(PLACEHOLDER_TEXT_COLOR, "placeholder-text-color") \
+    X(POSITION, "position") \
+    X(RIGHT, "right") \
+    X(SELECTION_BACKGROUND_COLOR, "selection-background-color") \
+    X(SELECTION_COLOR, "selection-color") \
+    X(SHOW_DECORATION_SELECTED, "show-decoration-selected") \
+    X(SPACING, "spacing") \
+    X(SUBCONTROL_ORIGIN, "subcontrol-origin") \
+    X(SUBCONTROL_POSITION, "subcontrol-position") \
+    X(TEXT_ALIGN, "text-align") \
+    X(TEXT_DECORATION, "text-decoration") \
+    X(TITLEBAR_SHOW_TOOLTIPS_ON_BUTTONS, "titlebar-show-tooltips-on-buttons") \
+    X(TOP, "top") \
+    X(WIDGET_ANIMATION_DURATION, "widget-animation-duration") \
+    X(WIDTH, "width")
+
+namespace qss
+{
+    enum Property : quint8
+    {
+#define QSS_PROPERTY_ENUM(id, name) QSS_PROPERTY_##id,
+        QSS_KNOWN_PROPERTIES(QSS_PROPERTY_ENUM)
+#undef QSS_PROPERTY_ENUM
+        QSS_PROPERTY_COUNT,
+        QSS_PROPERTY_UNKNOWN = QSS_PROPERTY_COUNT
+    };
+
+    namespace detail
+    {
+#define QSS_PROPERTY_NAME(id, name) std::string_view{ name },
+        constexpr std::array<std::string_view, QSS_PROPERTY_COUNT> PropertyNames{ { QSS_KNOWN_PROPERTIES(QSS_PROPERTY_NAME) } };
+#undef QSS_PROPERTY_NAME
+
+        // Sparse enough that a collision free seed is found within a few tries
+        constexpr quint32 PropertyTableSize = 4096;
+
+        template <typename Char>
+        constexpr quint32 PropertyHash(const Char* data, std::size_t size, quint32 seed) noexcept
+        {
+            // FNV-1a over code units; only ASCII names are ever verified equal
+            quint32 hash = 2166136261u ^ seed;
+
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                hash ^= static_cast<quint32>(static_cast<typename std::make_unsigned<Char>::type>(data[i]));
+                hash *= 16777619u;
+            }
+
+            return (hash ^ (hash >> 15)) & (PropertyTableSize - 1);
+        }
+
+        constexpr quint32 FindPropertySeed() noexcept
+        {
+            // Slots are marked with the seed that claimed them, so nothing is cleared between tries
+            std::array<quint32, PropertyTableSize> owner{};
+
+            for (quint32 seed = 1; seed < 1024; ++seed)
+            {
+                bool collision = false;
+
+                for (std::size_t i = 0; i < PropertyNames.size() && !collision; ++i)
+                {
+                    auto slot = PropertyHash(PropertyNames[i].data(), PropertyNames[i].size(), seed);
+                    collision = owner[slot] == seed;
+                    owner[slot] = seed;
+                }
+
+                if (!collision)
+                {
+                    return seed;
+                }
+            }
+
+            return 0;
+        }
+
+        constexpr quint32 PropertySeed = FindPropertySeed();
+        static_assert(PropertySeed != 0, "No perfect hash seed for the known properties");
+
+        constexpr std::array<quint8, PropertyTableSize> BuildPropertyTable() noexcept
+        {
+            std::array<quint8, PropertyTableSize> table{};
+
+            for (auto& slot : table)
+            {
+                slot = QSS_PROPERTY_UNKNOWN;
+            }
+
+            for (std::size_t i = 0; i < PropertyNames.size(); ++i)
+            {
+                table[PropertyHash(PropertyNames[i].data(), PropertyNames[i].size(), PropertySeed)] = static_cast<quint8>(i);
+            }
+
+            return table;
+        }
+
+        constexpr std::array<quint8, PropertyTableSize> PropertyTable = BuildPropertyTable();
+
+        template <typename Char>
+        constexpr Property LookupProperty(const Char* data, std::size_t size) noexcept
+        {
+            const auto id = PropertyTable[PropertyHash(data, size, PropertySeed)];
+
+            if (id == QSS_PROPERTY_UNKNOWN || PropertyNames[id].size() != size)
+            {
+                return QSS_PROPERTY_UNKNOWN;
+            }
+
+            // One candidate at most, confirmed by a single compare
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                if (static_cast<quint32>(data[i]) != static_cast<quint32>(PropertyNames[id][i]))
+                {
+                    return QSS_PROPERTY_UNKNOWN;
+                }
+            }
+
+            return static_cast<Property>(id);
+        }
+    }
+
+    // Maps a property name to its id with one hash and one compare, or
+    // QSS_PROPERTY_UNKNOWN for custom names such as qproperty-*
+    constexpr Property propertyFromName(std::string_view name) noexcept
+    {
+        return detail::LookupProperty(name.data(), name.size());
+    }
+
+    inline Property propertyFromName(QStringView name) noexcept
+    {
+        return detail::LookupProperty(name.utf16(), static_cast<std::size_t>(name.size()));
+    }
+
+    constexpr std::string_view propertyName(Property property) noexcept
+    {
+        return property < QSS_PROPERTY_COUNT ? detail::PropertyNames[property] : std::string_view{};
+    }
+
+    static_assert(propertyFromName(std::string_view{ "border-image" }) == QSS_PROPERTY_BORDER_IMAGE, "Property table mismatch");
+}
+
+#endif // QSSPROPERTY_H
@@ -2,20 +2,46 @@
 #define QSSPROPERTYBLOCK_H
 
 #include "qssparseable.h"
+#include "qssatom.h"
+#include "qssvalue.h"
 #include "qssexception.h"
+#include "qsslexer.h"
 
 namespace qss
 {
+    // Property names are atoms, so every block naming "color" shares one
+    // string and lookups compare pointers. Params are kept in insertion order
+    // in one contiguous array, with their atom ids mirrored in a second one.
+    // Small blocks, the common case, are searched by scanning the ids. Past
+    // IndexThreshold params an index is built: a slot per Property id for
+    // known names and a map for custom names (qproperty-*, typos). Values
+    // keep their text and parse into a typed reading when first asked. Every
+    // mutation through the methods below stamps the block with a new
+    // generation, which lets caches detect stale results, and updates an
+    // order independent hash of the params. Writes through the mutable
+    // iterators are tracked by neither.
     class QSS_API PropertyBlock : public IParseable
     {
     public:
 
-        typedef typename PropertyMap::const_iterator ConstItr;
-        typedef typename PropertyMap::iterator Itr;
+        typedef std::pair<Atom, InvalidablePair<PropertyValue>> Param;
+        typedef typename std::pmr::vector<Param>::const_iterator ConstItr;
+        typedef typename std::pmr::vector<Param>::iterator Itr;
+        typedef Allocator allocator_type;
+
+        static constexpr std::size_t IndexThreshold = 8;
 
         PropertyBlock() {}
+        explicit PropertyBlock(const allocator_type& allocator) : m_params{ allocator }, m_keys{ allocator } {}
         PropertyBlock(const QString& str);
+        PropertyBlock(const PropertyBlock& block) : PropertyBlock{ block, allocator_type{} } {}
+        PropertyBlock(const PropertyBlock& block, const allocator_type& allocator);
+        PropertyBlock(PropertyBlock&& block);
+        PropertyBlock(PropertyBlock&& block, const allocator_type& allocator);
         PropertyBlock& operator=(const PropertyBlock& block);
+        PropertyBlock& operator=(PropertyBlock&& block);
+
+        allocator_type get_allocator() const { return m_params.get_allocator(); }
 
         PropertyBlock& addParam(const QString& key, const QString& value);
         PropertyBlock& addParam(const QStringPairs& params);
@@ -25,11 +51,22 @@ namespace qss
         PropertyBlock& remove(const std::vector<QString>& keys);
 
         PropertyBlock& operator+=(const PropertyBlock& block);
+        PropertyBlock& operator+=(PropertyBlock&& block);
         PropertyBlock& operator+=(const QString& block);
+        PropertyBlock& operator+=(const Param& param);
 
         void    parse(const QString& input);
+        void    parse(const Lexer& lexer, const Lexer::Token& token);
+        void    parse(const Utf8Lexer& lexer, const Lexer::Token& token);
         QString toString() const;
         std::size_t size() const noexcept;
+        QString value(const QString& key) const;
+        QString value(Property property) const;
+        const PropertyValue* typedValue(const QString& key) const;
+        const PropertyValue* typedValue(Property property) const;
+        AtomList unknownParams() const;
+        quint64 generation() const noexcept { return m_generation; }
+        quint64 hash() const noexcept { return hashCombine(m_params.size(), m_hash); }
 
         ConstItr cbegin() const noexcept { return m_params.cbegin(); }
         ConstItr cend() const noexcept { return m_params.cend(); }
@@ -41,12 +78,37 @@ namespace qss
 
     private:
 
-        PropertyMap m_params;
+        static constexpr std::size_t npos = ~std::size_t{ 0 };
+
+        struct Index
+        {
+            std::array<quint32, QSS_PROPERTY_COUNT>           slots{};    // index + 1 into m_params, 0 if absent
+            std::unordered_map<Atom, std::size_t, AtomHasher> custom;
+        };
+
+        std::size_t indexOf(Atom key) const;
+        std::size_t indexOf(const QString& key) const;
+        void set(Atom key, InvalidablePair<PropertyValue> value);
+        void enable(std::size_t index, bool enable);
+        void erase(std::size_t index);
+        void addToIndex(std::size_t index);
+        void rebuildIndex();
+
+        static quint64 hash(const Param& param) noexcept;
+
+        std::pmr::vector<Param>   m_params;
+        std::pmr::vector<quint32> m_keys;   // atom ids, parallel to m_params
+        std::unique_ptr<Index>  m_index;
+        quint64                 m_generation = nextGeneration();
+        quint64                 m_hash = 0;     // sum of the param hashes
     };
 
     bool operator==(const PropertyBlock& lhs, const PropertyBlock& rhs);
+    inline bool operator!=(const PropertyBlock& lhs, const PropertyBlock& rhs) { return !(lhs == rhs); }
+    inline std::size_t qHash(const PropertyBlock& block, std::size_t seed = 0) noexcept { return static_cast<std::size_t>(hashCombine(seed, block.hash())); }
     
     PropertyBlock operator+(const PropertyBlock& lhs, const PropertyBlock& rhs);
+    PropertyBlock operator+(PropertyBlock&& lhs, const PropertyBlock& rhs);
 }
 
 #endif // QSSBLOCK_H
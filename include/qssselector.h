@@ -9,12 +9,22 @@ namespace qss
     {
     public:
 
-        typedef typename std::deque<SelectorElement>::const_iterator ConstItr;
-        typedef typename std::deque<SelectorElement>::iterator Itr;
+        typedef typename std::pmr::deque<SelectorElement>::const_iterator ConstItr;
+        typedef typename std::pmr::deque<SelectorElement>::iterator Itr;
+        typedef Allocator allocator_type;
 
         Selector() {}
+        explicit Selector(const allocator_type& allocator) : m_fragments{ allocator } {}
+        Selector(const Selector& selector) : Selector{ selector, allocator_type{} } {}
+        Selector(const Selector& selector, const allocator_type& allocator) : m_fragments{ selector.m_fragments, allocator } {}
+        Selector(Selector&& selector) : m_fragments{ std::move(selector.m_fragments) } {}
+        Selector(Selector&& selector, const allocator_type& allocator) : m_fragments{ std::move(selector.m_fragments), allocator } {}
         Selector(const QString& str);
+        Selector(const QString& str, const allocator_type& allocator);
         Selector& operator=(const Selector& selector);
+        Selector& operator=(Selector&& selector);
+
+        allocator_type get_allocator() const { return m_fragments.get_allocator(); }
 
         Selector& addChild(const SelectorElement& fragment);
         Selector& addChild(const QString& fragment);
@@ -26,10 +36,21 @@ namespace qss
         Selector& addSibling(const QString& fragment);
         Selector& append(const QString& fragment, SelectorElement::PositionType type);
         Selector& append(const SelectorElement& fragment, SelectorElement::PositionType type);
+        Selector& append(SelectorElement&& fragment, SelectorElement::PositionType type);
+
+        // Constructs the element in place from args, e.g. a QString to parse
+        template <typename... Args>
+        Selector& emplace(SelectorElement::PositionType type, Args&&... args);
 
         void    parse(const QString& input);
+        bool    parse(const QString& input, int& error);
         QString toString() const;
         std::size_t fragmentCount() const  noexcept { return m_fragments.size(); }
+        Specificity specificity(int first = 0, int last = -1) const;
+
+        // Folds the cached hashes of the elements, so it stays correct
+        // when elements are edited through the mutable accessors
+        quint64 hash() const noexcept;
 
         ConstItr cbegin() const noexcept { return m_fragments.cbegin(); }
         ConstItr cend() const noexcept { return m_fragments.cend(); }
@@ -51,15 +72,26 @@ namespace qss
 
     private:
 
+        bool parse(const QString& input, int* error);
         void preProcess(QString& str);
 
         const static char PreProcessChar = '`';
         const static std::unordered_map<QString, SelectorElement::PositionType, QStringHasher> Combinators;
 
-        std::deque<SelectorElement> m_fragments;
+        std::pmr::deque<SelectorElement> m_fragments;
     };
 
+    template <typename... Args>
+    Selector& Selector::emplace(SelectorElement::PositionType type, Args&&... args)
+    {
+        m_fragments.emplace_back(std::forward<Args>(args)...);
+        m_fragments.back().setPosition(type);
+        return *this;
+    }
+
     bool operator==(const Selector& lhs, const Selector& rhs);
+    inline bool operator!=(const Selector& lhs, const Selector& rhs) { return !(lhs == rhs); }
+    inline std::size_t qHash(const Selector& selector, std::size_t seed = 0) noexcept { return static_cast<std::size_t>(hashCombine(seed, selector.hash())); }
 }
 
 #endif // QSSSELECTOR_H
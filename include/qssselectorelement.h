@@ -2,10 +2,40 @@
 #define QSSSELECTORFRAGMENT_H
 
 #include "qssparseable.h"
+#include "qssatom.h"
 #include "qssexception.h"
 
+#include <tuple>
+
 namespace qss
 {
+    // CSS specificity: ids, then classes, params and pseudo classes, then
+    // type names and sub-controls. Compared lexicographically.
+    struct QSS_API Specificity
+    {
+        int ids = 0;
+        int classes = 0;
+        int types = 0;
+
+        Specificity& operator+=(const Specificity& other)
+        {
+            ids += other.ids;
+            classes += other.classes;
+            types += other.types;
+            return *this;
+        }
+
+        friend bool operator<(const Specificity& lhs, const Specificity& rhs)
+        {
+            return std::tie(lhs.ids, lhs.classes, lhs.types) < std::tie(rhs.ids, rhs.classes, rhs.types);
+        }
+
+        friend bool operator==(const Specificity& lhs, const Specificity& rhs)
+        {
+            return std::tie(lhs.ids, lhs.classes, lhs.types) == std::tie(rhs.ids, rhs.classes, rhs.types);
+        }
+    };
+
     class QSS_API SelectorElement : public IParseable
     {
     public:
@@ -15,9 +45,20 @@ namespace qss
             ADJACENT, PARENT, CHILD, DESCENDANT, SIBLING, GENERAL_SIBLING
         };
 
+        typedef Allocator allocator_type;
+
         SelectorElement() {}
+        explicit SelectorElement(const allocator_type& allocator) : m_params{ allocator }, m_classes{ allocator } {}
+        SelectorElement(const SelectorElement& element) : SelectorElement{ element, allocator_type{} } {}
+        SelectorElement(const SelectorElement& element, const allocator_type& allocator);
+        SelectorElement(SelectorElement&& element);
+        SelectorElement(SelectorElement&& element, const allocator_type& allocator);
         SelectorElement(const QString& str);
+        SelectorElement(const QString& str, const allocator_type& allocator);
         SelectorElement& operator=(const SelectorElement& fragment);
+        SelectorElement& operator=(SelectorElement&& fragment);
+
+        allocator_type get_allocator() const { return m_classes.get_allocator(); }
 
         SelectorElement& select(const QString& sel);
         SelectorElement& on(const QString& key, const QString& value);
@@ -25,21 +66,25 @@ namespace qss
         SelectorElement& sub(const QString& name);
         SelectorElement& when(const QString& pcl);
         SelectorElement& name(const QString& str);
+        SelectorElement& addClass(const QString& cl);
 
         void    parse(const QString& input);
+        bool    parse(const QString& input, int& error);
         QString toString() const;
         bool    isGeneralizedFrom(const SelectorElement& fragment) const;
         bool    isSpecificThan(const SelectorElement& fragment) const;
-        QString id() const { return m_id; }
+        Specificity specificity() const;
+        quint64 hash() const noexcept;
+        Atom    id() const noexcept { return m_id; }
         QString psuedoClass() const { return m_psuedoClass; }
-        QString subControl() const { return m_subControl; }
-        QString name() const { return m_name; }
+        Atom    subControl() const noexcept { return m_subControl; }
+        Atom    name() const noexcept { return m_name; }
         QString value(const QString& key) const;
 
         PositionType position() const noexcept { return m_position; }
 
-        const QStringList& classes() const noexcept { return m_classes; }
-        const QStringMap& params() const noexcept { return m_params; }
+        const AtomList& classes() const noexcept { return m_classes; }
+        const AtomMap& params() const noexcept { return m_params; }
 
         std::size_t classCount() const noexcept { return m_classes.size(); }
         std::size_t paramCount() const noexcept { return m_params.size(); }
@@ -51,21 +96,32 @@ namespace qss
         static const std::unordered_map<int, QString> Combinators;
 
         friend class Selector;
+        friend class Writer;
 
         QString extractSubControlAndPsuedoClass(const QString& str);
-        QString extractParams(const QString& str);
-        void    extractNameAndSelector(const QString& str);
-
-        QString      m_name;
-        QString      m_id;
-        QString      m_subControl;
+        bool    parse(const QString& input, int* error);
+        bool    extractParams(QString& str, int* error);
+        bool    extractNameAndSelector(const QString& str, int* error);
+        void    setPosition(PositionType position) noexcept { m_position = position; rehash(); }
+        quint64 computeHash() const noexcept;
+        void    rehash() noexcept { m_hash = computeHash(); }
+
+        Atom         m_name;
+        Atom         m_id;
+        Atom         m_subControl;
         QString      m_psuedoClass;
-        QStringMap   m_params;
+        AtomMap      m_params;
         PositionType m_position = PARENT;
-        QStringList  m_classes;
+        AtomList     m_classes;
+        // Recomputed by every mutation, so reading it never writes and const
+        // elements can be compared from several threads. 0 in a default
+        // constructed or moved from element, which hash() computes on demand.
+        quint64      m_hash = 0;
     };
 
     bool operator==(const SelectorElement& lhs, const SelectorElement& rhs);
+    inline bool operator!=(const SelectorElement& lhs, const SelectorElement& rhs) { return !(lhs == rhs); }
+    inline std::size_t qHash(const SelectorElement& element, std::size_t seed = 0) noexcept { return static_cast<std::size_t>(hashCombine(seed, element.hash())); }
 }
 
 #endif // QSSSELECTORFRAGMENT_H
@@ -0,0 +1,249 @@
+#ifndef QSSSNAPSHOT_H
+#define QSSSNAPSHOT_H
+
+#include "qssdocument.h"
+
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+
+namespace qss
+{
+    // An immutable version of a document that any number of threads can
+    // read at once. Fragments are sealed on the way in: moved out of any
+    // arena, their hashes computed and their values parsed, so reading them
+    // never writes to a lazily filled cache. A sealed fragment is shared by
+    // every later version that keeps it.
+    //
+    // The fragment list is a persistent tree with 32 entries per node.
+    // Copying a snapshot is O(1), which makes a vector of snapshots a cheap
+    // undo history. Replacing, enabling or appending a fragment copies only
+    // the nodes on its path, O(log32 n) pointers. Lookups by selector go
+    // through a persistent index of selector hashes, shared between versions
+    // the same way and updated along with the tree, so find() and value()
+    // read O(log32 n) nodes plus the fragments they return.
+    //
+    // Known gap: withInserted, except at the end, and withoutFragment are
+    // O(n). The tree finds entries by index bits alone, so shifting them
+    // rebuilds every node, n / 32 allocations and n reference count bumps,
+    // though no fragment is copied. A relaxed radix balanced tree would
+    // make them O(log n); until then, batch such edits through toDocument().
+    class QSS_API Snapshot
+    {
+    public:
+
+        struct Entry
+        {
+            std::shared_ptr<const Fragment> fragment;
+            bool                            enabled = true;
+        };
+
+        class QSS_API ConstItr
+        {
+        public:
+
+            typedef std::forward_iterator_tag iterator_category;
+            typedef Entry                     value_type;
+            typedef std::ptrdiff_t            difference_type;
+            typedef const Entry*              pointer;
+            typedef const Entry&              reference;
+
+            ConstItr() {}
+
+            reference operator*() const noexcept { return *m_entry; }
+            pointer operator->() const noexcept { return m_entry; }
+            ConstItr& operator++();
+            ConstItr operator++(int) { auto itr = *this; ++*this; return itr; }
+
+            friend bool operator==(const ConstItr& lhs, const ConstItr& rhs) noexcept { return lhs.m_index == rhs.m_index; }
+            friend bool operator!=(const ConstItr& lhs, const ConstItr& rhs) noexcept { return lhs.m_index != rhs.m_index; }
+
+        private:
+
+            friend class Snapshot;
+
+            ConstItr(const Snapshot* snapshot, std::size_t index);
+
+            const Snapshot* m_snapshot = nullptr;
+            std::size_t     m_index = 0;
+            const Entry*    m_entry = nullptr;  // walks a leaf, refetched at its end
+        };
+
+        Snapshot() {}
+        explicit Snapshot(const Document& document);
+        explicit Snapshot(Document&& document);
+
+        // Each returns a new version and leaves this one as it was
+        Snapshot withFragment(std::size_t index, Fragment fragment) const;
+        Snapshot withEnabled(std::size_t index, bool enable) const;
+        Snapshot withAppended(Fragment fragment, bool enabled = true) const;
+        Snapshot withInserted(std::size_t index, Fragment fragment, bool enabled = true) const;
+        Snapshot withoutFragment(std::size_t index) const;
+
+        const Fragment& operator[](std::size_t index) const { return *entry(index).fragment; }
+        bool isEnabled(std::size_t index) const { return entry(index).enabled; }
+        std::shared_ptr<const Fragment> fragment(std::size_t index) const { return entry(index).fragment; }
+        std::size_t totalFragments() const noexcept { return m_size; }
+
+        // Unique to each version, as Document::generation is to each edit
+        quint64 generation() const noexcept { return m_generation; }
+
+        std::vector<std::size_t> find(const QString& selector) const;
+        QString value(const QString& selector, const QString& key) const;
+        Document toDocument() const;
+        QString toString() const;
+
+        ConstItr cbegin() const { return ConstItr{ this, 0 }; }
+        ConstItr cend() const { return ConstItr{ this, m_size }; }
+        ConstItr begin() const { return cbegin(); }
+        ConstItr end() const { return cend(); }
+
+    private:
+
+        struct Node;
+        struct IndexNode;
+
+        // The indices, ascending, of the fragments whose selector hashes to hash
+        struct Positions
+        {
+            quint64                  hash;
+            std::vector<std::size_t> indices;
+        };
+
+        static constexpr int         Bits = 5;
+        static constexpr std::size_t Width = std::size_t{ 1 } << Bits;
+
+        static Entry seal(Fragment&& fragment, bool enabled);
+        static std::shared_ptr<const Node> assign(const Node& node, int shift, std::size_t index, Entry&& entry);
+        static std::shared_ptr<const Node> push(const Node* node, int shift, std::size_t index, Entry&& entry);
+        static std::shared_ptr<const IndexNode> buildIndex(std::vector<Positions>&& buckets, int shift);
+        static std::shared_ptr<const IndexNode> indexed(const IndexNode* node, int shift, quint64 hash, std::size_t index, bool add);
+
+        const std::vector<std::size_t>* positions(quint64 hash) const;
+
+        const Entry& entry(std::size_t index) const;
+        const Entry* leaf(std::size_t index) const;
+        std::vector<Entry> entries() const;
+        void build(std::vector<Entry>&& entries);
+
+        std::shared_ptr<const Node>      m_root;
+        std::shared_ptr<const IndexNode> m_index;
+        std::size_t                      m_size = 0;
+        int                              m_shift = 0;    // Bits per level above the leaves
+        quint64                     m_generation = nextGeneration();
+    };
+
+    // Publishes snapshots to reader threads, which always see one whole
+    // version, never a mix. Readers never block. Each pins the current
+    // version while it reads it, and a writer swaps in the next version
+    // atomically. Writers are serialized by a mutex; update() runs an edit
+    // on the current version under it, so concurrent edits are not lost.
+    //
+    // Every count a reader writes is striped per thread on its own cache
+    // line, so readers do not contend with each other. A reader counts
+    // itself in the epoch it started in only while it loads the current
+    // version and pins it. Each commit frees every replaced version that
+    // no reader has pinned and that no reader can still be loading, which
+    // is certain once the epoch has advanced twice since its replacement.
+    // The epoch advances whenever the previous one has no reader left in
+    // it, and that window is a few instructions long, so versions are freed
+    // under continuous reads too. A reader that stays pinned holds back its
+    // own version only.
+    //
+    // snapshot() copies the version, which bumps the reference count of
+    // its root, shared by every reader. read() runs a function on the
+    // pinned version without copying it, so a reader writes only its own
+    // stripes.
+    class QSS_API SharedDocument
+    {
+    public:
+
+        SharedDocument() : SharedDocument{ Snapshot{} } {}
+        explicit SharedDocument(Snapshot snapshot);
+        ~SharedDocument();
+
+        SharedDocument(const SharedDocument&) = delete;
+        SharedDocument& operator=(const SharedDocument&) = delete;
+
+        Snapshot snapshot() const;
+        void publish(Snapshot snapshot);
+
+        // Returns read(current), where current must not outlive the call
+        template <typename Read>
+        auto read(Read read) const;
+
+        // edit takes the current Snapshot and returns the next one, which is
+        // published and returned
+        template <typename Edit>
+        Snapshot update(Edit edit);
+
+        // Replaced versions not freed yet, because a reader may still use them
+        std::size_t retiredVersions();
+
+    private:
+
+        static constexpr std::size_t Stripes = 16;
+        static constexpr std::size_t CacheLine = 64;
+
+        struct alignas(CacheLine) Counter
+        {
+            std::atomic<int> value{ 0 };
+        };
+
+        struct Version
+        {
+            explicit Version(Snapshot&& snapshot) : snapshot{ std::move(snapshot) } {}
+
+            Snapshot                             snapshot;
+            mutable std::array<Counter, Stripes> pins;     // readers using it, per stripe
+        };
+
+        struct Retired
+        {
+            std::unique_ptr<const Version> version;
+            quint64                        epoch;          // the epoch it was replaced in
+        };
+
+        // Unpins its version when it goes out of scope
+        struct Pin
+        {
+            Pin(const Version* version, std::size_t stripe) : version{ version }, stripe{ stripe } {}
+            Pin(const Pin&) = delete;
+            Pin& operator=(const Pin&) = delete;
+            ~Pin() { version->pins[stripe].value.fetch_sub(1); }
+
+            const Version* version;
+            std::size_t    stripe;
+        };
+
+        static std::size_t stripe();
+        Pin pin() const;
+        void install(Snapshot&& snapshot);
+        int entering(quint64 epoch) const;
+
+        std::atomic<const Version*>                 m_current;
+        std::atomic<quint64>                        m_epoch{ 0 };
+        mutable std::array<Counter, 2 * Stripes>    m_entering;     // readers loading m_current, per epoch parity and stripe
+        std::mutex                                  m_writer;
+        std::vector<Retired>                        m_retired;      // replaced, maybe still pinned
+    };
+
+    template <typename Read>
+    auto SharedDocument::read(Read read) const
+    {
+        const auto pinned = pin();
+        return read(pinned.version->snapshot);
+    }
+
+    template <typename Edit>
+    Snapshot SharedDocument::update(Edit edit)
+    {
+        std::lock_guard<std::mutex> lock{ m_writer };
+        Snapshot next = edit(m_current.load()->snapshot);
+        install(Snapshot{ next });
+        return next;
+    }
+}
+
+#endif // QSSSNAPSHOT_H
@@ -0,0 +1,321 @@
+#ifndef QSSSTATICDOCUMENT_H
+#define QSSSTATICDOCUMENT_H
+
+#include "qssdocument.h"
+#include "qssexception.h"
+#include "qssproperty.h"
+
+#include <array>
+#include <string_view>
+
+namespace qss
+{
+    struct StaticDeclaration
+    {
+        std::string_view key;
+        std::string_view value;
+        Property         property = QSS_PROPERTY_UNKNOWN;   // resolved while compiling
+    };
+
+    struct StaticFragment
+    {
+        std::string_view selector;
+        std::size_t      firstDeclaration = 0;
+        std::size_t      declarationCount = 0;
+    };
+
+    namespace detail
+    {
+        [[noreturn]] QSS_API void StaticSyntaxError(int code, const char* reason);
+
+        constexpr bool IsStaticSpace(char c) noexcept
+        {
+            return c == ' ' || (c >= '\t' && c <= '\r');
+        }
+
+        // The significant characters of a selector, key or value. Comments
+        // and spaces around it are dropped; a comment inside it cannot be cut
+        // out of a slice, so it is rejected.
+        struct StaticSegment
+        {
+            std::size_t begin = std::string_view::npos;
+            std::size_t end = 0;
+            bool        commented = false;
+
+            constexpr void add(std::size_t from, std::size_t to)
+            {
+                if (begin == std::string_view::npos)
+                {
+                    begin = from;
+                }
+                else if (commented)
+                {
+                    StaticSyntaxError(Exception::BLOCK_PARAM_INVALID, "comment inside a selector or declaration");
+                }
+
+                end = to;
+            }
+
+            constexpr void comment() noexcept { commented = begin != std::string_view::npos; }
+            constexpr bool isEmpty() const noexcept { return begin == std::string_view::npos; }
+            constexpr std::string_view view(std::string_view text) const { return isEmpty() ? std::string_view{} : text.substr(begin, end - begin); }
+        };
+
+        // Walks "selector { key: value; ... }" fragments, reporting them to the
+        // visitor. Unlike the runtime lexer, which drops an unterminated
+        // trailing fragment, anything malformed is an error.
+        template <typename Visitor>
+        constexpr void ScanStatic(std::string_view text, Visitor& visitor)
+        {
+            StaticSegment segment;
+            std::string_view key;
+            bool inBlock = false;
+            bool inValue = false;
+
+            for (std::size_t i = 0; i < text.size(); ++i)
+            {
+                const char c = text[i];
+
+                if (c == '/' && i + 1 < text.size() && text[i + 1] == '*')
+                {
+                    const auto close = text.find("*/", i + 2);
+
+                    if (close == std::string_view::npos)
+                    {
+                        StaticSyntaxError(Exception::BLOCK_PARAM_INVALID, "unterminated comment");
+                    }
+
+                    segment.comment();
+                    i = close + 1;
+                }
+                else if (IsStaticSpace(c))
+                {
+                    continue;
+                }
+                else if (c == '"' || c == '\'')
+                {
+                    auto close = i + 1;
+
+                    while (close < text.size() && text[close] != c)
+                    {
+                        close += text[close] == '\\' ? 2 : 1;
+                    }
+
+                    if (close >= text.size())
+                    {
+                        StaticSyntaxError(Exception::BLOCK_PARAM_INVALID, "unterminated string");
+                    }
+
+                    segment.add(i, close + 1);
+                    i = close;
+                }
+                else if (c == '\\')
+                {
+                    if (i + 1 >= text.size())
+                    {
+                        StaticSyntaxError(Exception::BLOCK_PARAM_INVALID, "escape at the end of the input");
+                    }
+
+                    segment.add(i, i + 2);
+                    ++i;
+                }
+                else if (!inBlock)
+                {
+                    if (c == '{')
+                    {
+                        if (segment.isEmpty())
+                        {
+                            StaticSyntaxError(Exception::SELECTOR_INVALID, "block without a selector");
+                        }
+
+                        visitor.fragment(segment.view(text));
+                        segment = StaticSegment{};
+                        inBlock = true;
+                        inValue = false;
+                    }
+                    else if (c == '}' || c == ';')
+                    {
+                        StaticSyntaxError(Exception::BLOCK_BRACKETS_INVALID, "'}' or ';' outside a block");
+                    }
+                    else
+                    {
+                        segment.add(i, i + 1);
+                    }
+                }
+                else if (c == '{')
+                {
+                    StaticSyntaxError(Exception::BLOCK_BRACKETS_INVALID, "nested block");
+                }
+                else if (c == ':' && !inValue)
+                {
+                    if (segment.isEmpty())
+                    {
+                        StaticSyntaxError(Exception::BLOCK_PARAM_INVALID, "declaration without a property name");
+                    }
+
+                    key = segment.view(text);
+                    segment = StaticSegment{};
+                    inValue = true;
+                }
+                else if (c == ';' || c == '}')
+                {
+                    if (inValue)
+                    {
+                        if (segment.isEmpty())
+                        {
+                            StaticSyntaxError(Exception::BLOCK_PARAM_INVALID, "declaration without a value");
+                        }
+
+                        visitor.declaration(key, segment.view(text));
+                    }
+                    else if (!segment.isEmpty())
+                    {
+                        StaticSyntaxError(Exception::BLOCK_PARAM_INVALID, "declaration without ':'");
+                    }
+
+                    segment = StaticSegment{};
+                    inValue = false;
+                    inBlock = c != '}';
+                }
+                else
+                {
+                    segment.add(i, i + 1);
+                }
+            }
+
+            if (inBlock)
+            {
+                StaticSyntaxError(Exception::BLOCK_BRACKETS_INVALID, "unclosed block");
+            }
+
+            if (!segment.isEmpty())
+            {
+                StaticSyntaxError(Exception::SELECTOR_INVALID, "selector without a block");
+            }
+        }
+
+        struct StaticCounter
+        {
+            std::size_t fragments = 0;
+            std::size_t declarations = 0;
+
+            constexpr void fragment(std::string_view) noexcept { ++fragments; }
+            constexpr void declaration(std::string_view, std::string_view) noexcept { ++declarations; }
+        };
+
+        constexpr StaticCounter CountStatic(std::string_view text)
+        {
+            StaticCounter counter;
+            ScanStatic(text, counter);
+            return counter;
+        }
+    }
+
+    class QSS_API StaticDocumentBase
+    {
+    protected:
+
+        static Document toDocument(const StaticFragment* fragments, std::size_t fragmentCount, const StaticDeclaration* declarations);
+    };
+
+    // A stylesheet split into selector and declaration tables during
+    // compilation; see QSS_LITERAL. Keys and values are slices of the literal
+    // and known property names are already resolved to their ids, so reading
+    // the tables costs nothing at runtime. toDocument() builds the mutable
+    // model, e.g. for a Matcher, without lexing the text again. Constructed
+    // directly, the counts must match the text exactly, as QSS_LITERAL
+    // guarantees, or construction fails like malformed syntax.
+    template <std::size_t FragmentCount, std::size_t DeclarationCount>
+    class StaticDocument : public StaticDocumentBase
+    {
+    public:
+
+        constexpr explicit StaticDocument(std::string_view text)
+        {
+            Filler filler{ m_fragments, m_declarations };
+            detail::ScanStatic(text, filler);
+
+            if (filler.fragmentCount != FragmentCount)
+            {
+                detail::StaticSyntaxError(Exception::SELECTOR_INVALID, "fewer fragments than FragmentCount");
+            }
+
+            if (filler.declarationCount != DeclarationCount)
+            {
+                detail::StaticSyntaxError(Exception::BLOCK_PARAM_INVALID, "fewer declarations than DeclarationCount");
+            }
+        }
+
+        constexpr std::size_t totalFragments() const noexcept { return FragmentCount; }
+        constexpr std::size_t totalDeclarations() const noexcept { return DeclarationCount; }
+        constexpr const StaticFragment& operator[](std::size_t index) const { return m_fragments[index]; }
+        constexpr const StaticDeclaration& declaration(const StaticFragment& fragment, std::size_t index) const
+        {
+            return m_declarations[fragment.firstDeclaration + index];
+        }
+
+        // Later declarations override earlier ones, as in PropertyBlock
+        constexpr std::string_view value(std::size_t fragment, Property property) const
+        {
+            const auto& owner = m_fragments[fragment];
+
+            for (auto i = owner.declarationCount; i > 0; --i)
+            {
+                if (declaration(owner, i - 1).property == property)
+                {
+                    return declaration(owner, i - 1).value;
+                }
+            }
+
+            return std::string_view{};
+        }
+
+        constexpr auto begin() const noexcept { return m_fragments.begin(); }
+        constexpr auto end() const noexcept { return m_fragments.end(); }
+
+        Document toDocument() const { return StaticDocumentBase::toDocument(m_fragments.data(), FragmentCount, m_declarations.data()); }
+
+    private:
+
+        struct Filler
+        {
+            std::array<StaticFragment, FragmentCount>&       fragments;
+            std::array<StaticDeclaration, DeclarationCount>& declarations;
+            std::size_t                                      fragmentCount = 0;
+            std::size_t                                      declarationCount = 0;
+
+            constexpr void fragment(std::string_view selector)
+            {
+                if (fragmentCount == FragmentCount)
+                {
+                    detail::StaticSyntaxError(Exception::SELECTOR_INVALID, "more fragments than FragmentCount");
+                }
+
+                fragments[fragmentCount++] = StaticFragment{ selector, declarationCount, 0 };
+            }
+
+            constexpr void declaration(std::string_view key, std::string_view value)
+            {
+                if (declarationCount == DeclarationCount)
+                {
+                    detail::StaticSyntaxError(Exception::BLOCK_PARAM_INVALID, "more declarations than DeclarationCount");
+                }
+
+                declarations[declarationCount++] = StaticDeclaration{ key, value, propertyFromName(key) };
+                ++fragments[fragmentCount - 1].declarationCount;
+            }
+        };
+
+        std::array<StaticFragment, FragmentCount>       m_fragments{};
+        std::array<StaticDeclaration, DeclarationCount> m_declarations{};
+    };
+}
+
+// Compiles a stylesheet literal into a qss::StaticDocument. Used to
+// initialize a constexpr variable, malformed syntax fails the build at the
+// call to StaticSyntaxError naming the problem:
+//     constexpr auto theme = QSS_LITERAL("QLabel { color: red; }");
+#define QSS_LITERAL(text) \
+    ::qss::StaticDocument<::qss::detail::CountStatic(text).fragments, ::qss::detail::CountStatic(text).declarations>{ std::string_view{ text } }
+
+#endif // QSSSTATICDOCUMENT_H
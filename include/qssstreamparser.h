@@ -0,0 +1,43 @@
+#ifndef QSSSTREAMPARSER_H
+#define QSSSTREAMPARSER_H
+
+#include "qssfragment.h"
+
+#include <QIODevice>
+#include <QStringDecoder>
+
+#include <functional>
+
+namespace qss
+{
+    // Push style parser for QSS arriving in chunks. Every fragment is handed
+    // to the callback as soon as its closing bracket has been fed, and only
+    // the text of the fragment still being read is buffered. Comments, quoted
+    // strings and UTF-8 sequences may be split anywhere across chunks.
+    class QSS_API StreamParser
+    {
+    public:
+
+        typedef std::function<void(const Fragment&)> Callback;
+
+        StreamParser(const Callback& callback) : m_callback{ callback } {}
+
+        StreamParser& feed(const QString& chunk);
+        StreamParser& feed(QByteArrayView utf8);
+        StreamParser& read(QIODevice& device, qint64 chunkSize = 64 * 1024);
+        void finish();
+
+        std::size_t totalFragments() const noexcept { return m_total; }
+
+    private:
+
+        void emitFragments();
+
+        Callback       m_callback;
+        Lexer          m_lexer;
+        QStringDecoder m_decoder{ QStringDecoder::Utf8 };
+        std::size_t    m_total = 0;
+    };
+}
+
+#endif // QSSSTREAMPARSER_H
@@ -0,0 +1,54 @@
+#ifndef QSSSTYLECACHE_H
+#define QSSSTYLECACHE_H
+
+#include "qssmatcher.h"
+
+#include <memory>
+
+namespace qss
+{
+    // Memoizes Matcher::computeStyle per element signature: type, base
+    // types, id, classes, params, states and sub-control, plus the same for
+    // every ancestor and preceding sibling. An entry remembers the document
+    // generation and the generation of each block it was merged from, and is
+    // recomputed on its next lookup once any of them has changed, so edits
+    // never require flushing the whole cache. Selectors edited in place,
+    // without going through Document, are not detected; call clear(). The
+    // document is held by reference and must outlive the cache.
+    class QSS_API StyleCache
+    {
+    public:
+
+        explicit StyleCache(const Document& document) : m_document{ document } {}
+        StyleCache(Document&&) = delete;
+
+        const PropertyBlock& computeStyle(const Element& element);
+        void clear();
+
+        std::size_t hits() const noexcept { return m_hits; }
+        std::size_t misses() const noexcept { return m_misses; }
+        std::size_t size() const noexcept { return m_entries.size(); }
+
+        static QString signature(const Element& element);
+
+    private:
+
+        struct Entry
+        {
+            quint64                                    generation = 0;
+            std::vector<std::pair<std::size_t, quint64>> blocks;
+            PropertyBlock                              style;
+        };
+
+        bool isValid(const Entry& entry) const;
+
+        const Document&                                    m_document;
+        std::unique_ptr<Matcher>                           m_matcher;
+        quint64                                            m_matcherGeneration = 0;
+        std::unordered_map<QString, Entry, QStringHasher>  m_entries;
+        std::size_t                                        m_hits = 0;
+        std::size_t                                        m_misses = 0;
+    };
+}
+
+#endif // QSSSTYLECACHE_H
@@ -1,6 +1,7 @@
 #ifndef QSSUTILS_H
 #define QSSUTILS_H
 
+#include <QHash>
 #include <QString>
 #include <QStringList>
 
@@ -8,6 +9,7 @@
 #include <vector>
 #include <deque>
 #include <iostream>
+#include <memory_resource>
 #include <string>
 #include <type_traits>
 
@@ -26,38 +28,48 @@
 #endif // _WIN32
 
 
-#define LOG(X)  { std::cout << qss::tab(2) << X << std::endl; }
-#define START() { std::cout << qss::tab(1) << "In [" __FUNCTION__ << "]" << std::endl; }
-#define END() { qss::tab(0); std::cout << qss::tab(2) << "Out [" __FUNCTION__ << "]" << std::endl; }
-
 namespace qss
 {
-    inline std::string tab(int in)
+    struct QStringHasher
     {
-        static std::string _tabs;
-        auto local = _tabs;
-        switch (in)
+        std::size_t operator()(const QString& str) const
         {
-        case 1: _tabs.append("\t"); break;
-        case 2: break;
-        case 0: _tabs.erase(0, 1); break;
+            return qHash(str);
         }
-        return local;
+    };
+
+    // splitmix64 finalizer; spreads field hashes before they are combined
+    constexpr quint64 hashMix(quint64 value) noexcept
+    {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
     }
 
-    struct QStringHasher
+    constexpr quint64 hashCombine(quint64 seed, quint64 value) noexcept
     {
-        std::size_t operator()(const QString& str) const
+        return hashMix(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)));
+    }
+
+    // Hashes any qss type with a hash() member, for use in std containers
+    struct Hasher
+    {
+        template <typename T>
+        std::size_t operator()(const T& value) const noexcept
         {
-            return std::hash<std::string>()(str.toStdString());
+            return static_cast<std::size_t>(value.hash());
         }
     };
 
+    // The model classes are allocator aware: their containers draw from the
+    // memory resource they were constructed with, which std::pmr containers
+    // pass down to the elements they construct, see Document::withArena
+    typedef std::pmr::polymorphic_allocator<std::byte> Allocator;
+
     template <typename T> using InvalidablePair = std::pair<T, bool>;
     using QStringPair = std::pair<QString, QString>;
     using QStringPairs = std::vector<QStringPair>;
     using QStringMap = std::unordered_map<QString, QString, QStringHasher>;
-    using PropertyMap = std::unordered_map<QString, InvalidablePair<QString>, QStringHasher>;
 
     enum Delimiter
     {
@@ -99,6 +111,9 @@ namespace qss
         return QString{ "\"%1\"" }.arg(input);
     }
 
+    // Process wide, strictly increasing stamp used to track modifications
+    QSS_API quint64 nextGeneration() noexcept;
+
     QSS_API std::ostream& operator<<(std::ostream& stream, const QString& str);
     
     QSS_API std::ostream& operator<<(std::ostream& stream, const QStringList& list);
@@ -0,0 +1,108 @@
+#ifndef QSSVALUE_H
+#define QSSVALUE_H
+
+#include "qssutils.h"
+
+#include <QStringView>
+
+#include <memory>
+#include <optional>
+
+namespace qss
+{
+    // The raw text of a property value plus a typed reading of it, built on
+    // first access and shared by copies. Assigning new text drops the cached
+    // reading. The first typed access on a value is not synchronized, so a
+    // block read from several threads should be read once beforehand.
+    class QSS_API PropertyValue
+    {
+    public:
+
+        enum Type
+        {
+            KEYWORDS,   // anything else, e.g. "1px solid black"
+            COLOR,      // #rgb, #rrggbb, #aarrggbb, rgb[a](), hsv[a](), hsl[a]() or a named color
+            LENGTH,     // one or more lengths, e.g. "2px 4px"
+            URL,        // url(path)
+            GRADIENT    // qlineargradient(), qradialgradient() or qconicalgradient()
+        };
+
+        struct Color
+        {
+            quint8 red = 0;
+            quint8 green = 0;
+            quint8 blue = 0;
+            quint8 alpha = 255;
+
+            friend bool operator==(const Color& lhs, const Color& rhs)
+            {
+                return lhs.red == rhs.red && lhs.green == rhs.green && lhs.blue == rhs.blue && lhs.alpha == rhs.alpha;
+            }
+        };
+
+        struct Length
+        {
+            enum Unit { NONE, PX, PT, EM, EX };
+
+            double value = 0;
+            Unit   unit = NONE;
+        };
+
+        struct Gradient
+        {
+            enum Kind { LINEAR, RADIAL, CONICAL };
+
+            struct Stop
+            {
+                double position = 0;
+                Color  color;
+            };
+
+            Kind                                 kind = LINEAR;
+            QString                              spread;        // pad, repeat or reflect when given
+            std::vector<std::pair<QString, double>> coordinates; // x1, y1, cx, radius, angle, ...
+            std::vector<Stop>                    stops;
+
+            double coordinate(const QString& name, double fallback = 0) const;
+        };
+
+        PropertyValue() {}
+        PropertyValue(const QString& raw) : m_raw{ raw } {}
+        PropertyValue& operator=(const QString& raw);
+
+        const QString& toString() const noexcept { return m_raw; }
+        operator const QString&() const noexcept { return m_raw; }
+        bool isEmpty() const noexcept { return m_raw.isEmpty(); }
+        bool isParsed() const noexcept { return m_parsed != nullptr; }
+
+        Type                       type() const { return parsed().type; }
+        const QStringList&         keywords() const { return parsed().keywords; }
+        const std::vector<Length>& lengths() const { return parsed().lengths; }
+        const Color*               color() const;
+        const Length*              length() const;
+        const QString*             url() const;
+        const Gradient*            gradient() const;
+
+        static std::optional<Color>  parseColor(const QString& token);
+        static std::optional<Length> parseLength(const QString& token);
+
+    private:
+
+        struct Parsed
+        {
+            Type                type = KEYWORDS;
+            QStringList         keywords;
+            std::vector<Length> lengths;
+            Color               color;
+            QString             url;
+            Gradient            gradient;
+        };
+
+        const Parsed& parsed() const;
+
+        QString                               m_raw;
+        mutable std::shared_ptr<const Parsed> m_parsed;
+    };
+}
+
+#endif // QSSVALUE_H
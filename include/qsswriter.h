@@ -0,0 +1,88 @@
+#ifndef QSSWRITER_H
+#define QSSWRITER_H
+
+#include "qsssnapshot.h"
+
+#include <QIODevice>
+#include <QTextStream>
+
+#include <array>
+
+namespace qss
+{
+    // Serializes the model in one pass, appending straight into a QString or
+    // into a fixed chunk that is handed to a QTextStream or QIODevice (as
+    // UTF-8) whenever it fills up. Without a target it only counts, which is
+    // how toString() sizes its result before writing it in a single
+    // allocation. PRETTY matches toString(); MINIFIED drops every optional
+    // space, line break and trailing semicolon. The chunk is flushed on
+    // destruction or by flush().
+    class QSS_API Writer
+    {
+    public:
+
+        enum Mode
+        {
+            PRETTY,
+            MINIFIED
+        };
+
+        static constexpr qsizetype ChunkSize = 64 * 1024;
+
+        explicit Writer(Mode mode = PRETTY);
+        Writer(QString& output, Mode mode = PRETTY);
+        Writer(QTextStream& stream, Mode mode = PRETTY);
+        Writer(QIODevice& device, Mode mode = PRETTY);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        Writer& write(const Document& document);
+        Writer& write(const Snapshot& snapshot);
+        Writer& write(const Fragment& fragment);
+        Writer& write(const Selector& selector);
+        Writer& write(const SelectorElement& element);
+        Writer& write(const PropertyBlock& block);
+
+        void      flush();
+        Mode      mode() const noexcept { return m_mode; }
+        qsizetype size() const noexcept { return m_size; }
+
+        // Characters the model serializes to, without building the text
+        template <typename T>
+        static qsizetype measure(const T& model, Mode mode = PRETTY)
+        {
+            Writer counter{ mode };
+            counter.write(model);
+            return counter.size();
+        }
+
+        // The whole serialization in a string allocated once
+        template <typename T>
+        static QString toString(const T& model, Mode mode = PRETTY)
+        {
+            QString result;
+            result.reserve(measure(model, mode));
+            Writer{ result, mode }.write(model);
+            return result;
+        }
+
+    private:
+
+        void put(QStringView text);
+        void put(QChar c);
+        void put(Delimiter delimiter) { put(m_delimiters[delimiter]); }
+
+        Mode         m_mode;
+        QString*     m_output = nullptr;
+        QTextStream* m_stream = nullptr;
+        QIODevice*   m_device = nullptr;
+        QString      m_chunk;
+        qsizetype    m_size = 0;
+
+        std::array<QStringView, QSS_SUB_CONTROL_DELIMITER + 1> m_delimiters;
+    };
+}
+
+#endif // QSSWRITER_H
@@ -0,0 +1,110 @@
+#include "../include/qssatom.h"
+
+#include <mutex>
+#include <shared_mutex>
+
+namespace
+{
+    struct AtomTable
+    {
+        AtomTable()
+        {
+            // The empty string is always entry 0 and the known properties
+            // follow; they are resolved through seeded without a lock
+            add(QString{});
+
+            for (auto name : qss::detail::PropertyNames)
+            {
+                add(QString::fromLatin1(name.data(), static_cast<qsizetype>(name.size())));
+            }
+        }
+
+        const qss::Atom::Entry* add(const QString& str)
+        {
+            entries.push_back({ str, qHash(str), static_cast<quint32>(entries.size()) });
+            const auto* entry = &entries.back();
+
+            // The key shares the entry's string data, so each name is stored once
+            index.emplace(entry->string, entry);
+
+            if (entry->id < seeded.size())
+            {
+                seeded[entry->id] = entry;
+            }
+
+            return entry;
+        }
+
+        std::array<const qss::Atom::Entry*, qss::QSS_PROPERTY_COUNT + 1>    seeded{};
+        std::shared_mutex                                                   mutex;
+        std::deque<qss::Atom::Entry>                                        entries;
+        std::unordered_map<QString, const qss::Atom::Entry*, qss::QStringHasher> index;
+    };
+
+    AtomTable& Table()
+    {
+        static AtomTable table;
+        return table;
+    }
+}
+
+qss::Atom::Atom() noexcept : m_entry{ Table().seeded[0] }
+{
+}
+
+qss::Atom::Atom(Property property) noexcept : m_entry{ Table().seeded[property < QSS_PROPERTY_COUNT ? property + 1 : 0] }
+{
+}
+
+qss::Atom::Atom(const QString& str)
+{
+    auto& table = Table();
+
+    {
+        std::shared_lock<std::shared_mutex> lock{ table.mutex };
+        auto itr = table.index.find(str);
+
+        if (itr != table.index.cend())
+        {
+            m_entry = itr->second;
+            return;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock{ table.mutex };
+    auto itr = table.index.find(str);
+
+    if (itr != table.index.cend())
+    {
+        m_entry = itr->second;
+        return;
+    }
+
+    m_entry = table.add(str);
+}
+
+std::optional<qss::Atom> qss::Atom::find(const QString& str)
+{
+    auto& table = Table();
+    std::shared_lock<std::shared_mutex> lock{ table.mutex };
+    auto itr = table.index.find(str);
+
+    if (itr == table.index.cend())
+    {
+        return std::nullopt;
+    }
+
+    return Atom{ itr->second };
+}
+
+std::size_t qss::Atom::count()
+{
+    auto& table = Table();
+    std::shared_lock<std::shared_mutex> lock{ table.mutex };
+    return table.entries.size();
+}
+
+std::ostream& qss::operator<<(std::ostream& stream, Atom atom)
+{
+    return stream << atom.toString();
+}
@@ -0,0 +1,409 @@
+#include "../include/qsscompileddocument.h"
+
+#include <QFile>
+
+#include <cstdint>
+
+namespace
+{
+    template <typename T>
+    void Append(QByteArray& output, const std::vector<T>& records)
+    {
+        output.append(reinterpret_cast<const char*>(records.data()), static_cast<qsizetype>(records.size() * sizeof(T)));
+    }
+}
+
+qss::SelectorElement::PositionType qss::CompiledElement::position() const noexcept
+{
+    return static_cast<SelectorElement::PositionType>(m_document->m_elements[m_index].position);
+}
+
+QStringView qss::CompiledElement::name() const
+{
+    return m_document->string(m_document->m_elements[m_index].name);
+}
+
+QStringView qss::CompiledElement::id() const
+{
+    return m_document->string(m_document->m_elements[m_index].id);
+}
+
+QStringView qss::CompiledElement::subControl() const
+{
+    return m_document->string(m_document->m_elements[m_index].subControl);
+}
+
+QStringView qss::CompiledElement::psuedoClass() const
+{
+    return m_document->string(m_document->m_elements[m_index].psuedoClass);
+}
+
+std::size_t qss::CompiledElement::classCount() const noexcept
+{
+    return m_document->m_elements[m_index].classCount;
+}
+
+std::size_t qss::CompiledElement::paramCount() const noexcept
+{
+    return m_document->m_elements[m_index].paramCount;
+}
+
+QStringView qss::CompiledElement::className(std::size_t index) const
+{
+    const auto& record = m_document->m_elements[m_index];
+    return m_document->string(m_document->m_references[record.firstReference + index]);
+}
+
+qss::PropertyView qss::CompiledElement::param(std::size_t index) const
+{
+    const auto& record = m_document->m_elements[m_index];
+    const auto* pair = m_document->m_references + record.firstReference + record.classCount + 2 * index;
+    return PropertyView{ m_document->string(pair[0]), m_document->string(pair[1]) };
+}
+
+qss::SelectorElement qss::CompiledElement::toElement() const
+{
+    SelectorElement element;
+    element.select(name().toString());
+    element.name(id().toString());
+    element.sub(subControl().toString());
+    element.when(psuedoClass().toString());
+
+    for (std::size_t i = 0; i < classCount(); ++i)
+    {
+        element.addClass(className(i).toString());
+    }
+
+    for (std::size_t i = 0; i < paramCount(); ++i)
+    {
+        const auto pair = param(i);
+        element.on(pair.key().toString(), pair.value().toString());
+    }
+
+    return element;
+}
+
+bool qss::CompiledFragment::isEnabled() const noexcept
+{
+    return m_document->m_fragments[m_index].enabled != 0;
+}
+
+std::size_t qss::CompiledFragment::elementCount() const noexcept
+{
+    return m_document->m_fragments[m_index].elementCount;
+}
+
+qss::CompiledElement qss::CompiledFragment::element(std::size_t index) const
+{
+    return CompiledElement{ m_document, m_document->m_fragments[m_index].firstElement + index };
+}
+
+qss::PropertyView qss::CompiledFragment::operator[](std::size_t index) const
+{
+    const auto& record = m_document->m_properties[m_document->m_fragments[m_index].firstProperty + index];
+    return PropertyView{ m_document->string(record.key), m_document->string(record.value) };
+}
+
+bool qss::CompiledFragment::isEnabled(std::size_t index) const noexcept
+{
+    return m_document->m_properties[m_document->m_fragments[m_index].firstProperty + index].enabled != 0;
+}
+
+std::size_t qss::CompiledFragment::size() const noexcept
+{
+    return m_document->m_fragments[m_index].propertyCount;
+}
+
+QStringView qss::CompiledFragment::value(QStringView key) const
+{
+    for (std::size_t i = 0; i < size(); ++i)
+    {
+        const auto property = (*this)[i];
+
+        if (isEnabled(i) && property.key() == key)
+        {
+            return property.value();
+        }
+    }
+
+    return QStringView{};
+}
+
+qss::Fragment qss::CompiledFragment::toFragment() const
+{
+    Selector selector;
+
+    for (std::size_t i = 0; i < elementCount(); ++i)
+    {
+        const auto compiled = element(i);
+        selector.append(compiled.toElement(), compiled.position());
+    }
+
+    Fragment fragment;
+    fragment.select(std::move(selector));
+
+    for (std::size_t i = 0; i < size(); ++i)
+    {
+        const auto property = (*this)[i];
+        fragment.block() += PropertyBlock::Param{ Atom{ property.key().toString() },
+            std::make_pair(PropertyValue{ property.value().toString() }, isEnabled(i)) };
+    }
+
+    return fragment;
+}
+
+qss::CompiledDocument::CompiledDocument(const QByteArray& data)
+{
+    // Kept in a shared_ptr so that copies of the view never own a separate buffer
+    auto bytes = std::make_shared<const QByteArray>(data);
+    load(reinterpret_cast<const uchar*>(bytes->constData()), bytes->size());
+    m_owner = std::move(bytes);
+}
+
+qss::CompiledDocument qss::CompiledDocument::fromFile(const QString& path)
+{
+    auto file = std::make_shared<QFile>(path);
+
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        throw Exception{ Exception::FILE_UNREADABLE, path };
+    }
+
+    const auto size = file->size();
+    auto data = size > 0 ? file->map(0, size) : nullptr;
+
+    if (data == nullptr)
+    {
+        // Compressed resources and some devices cannot be mapped
+        return CompiledDocument{ file->readAll() };
+    }
+
+    // The mapping lives as long as the file, which the views keep open
+    CompiledDocument document;
+    document.load(data, size);
+    document.m_owner = std::move(file);
+    return document;
+}
+
+QByteArray qss::CompiledDocument::compile(const Document& document)
+{
+    Header header{ Magic, Version, 0, 0, 0, 0, 0, 0 };
+    std::vector<FragmentRecord> fragments;
+    std::vector<ElementRecord> elements;
+    std::vector<PropertyRecord> properties;
+    std::vector<quint32> references;
+    std::vector<StringRecord> strings{ StringRecord{ 0, 0 } };
+    std::unordered_map<QString, quint32, QStringHasher> ids{ { QString{}, 0 } };
+    QString characters;
+
+    // Index 0 is the empty string, so absent fields cost nothing
+    auto intern = [&](const QString& string) {
+        auto result = ids.emplace(string, static_cast<quint32>(strings.size()));
+
+        if (result.second)
+        {
+            strings.push_back(StringRecord{ static_cast<quint32>(characters.size()), static_cast<quint32>(string.size()) });
+            characters += string;
+        }
+
+        return result.first->second;
+    };
+
+    fragments.reserve(document.totalFragments());
+
+    for (const auto& pair : document)
+    {
+        const auto& fragment = pair.first;
+        FragmentRecord record{ static_cast<quint32>(elements.size()), 0, static_cast<quint32>(properties.size()), 0, pair.second ? 1u : 0u };
+
+        for (const auto& element : fragment.selector())
+        {
+            ElementRecord compiled{ static_cast<quint32>(element.position()), intern(element.name()), intern(element.id()),
+                intern(element.subControl()), intern(element.psuedoClass()), static_cast<quint32>(references.size()),
+                static_cast<quint32>(element.classCount()), static_cast<quint32>(element.paramCount()) };
+
+            for (const auto& cl : element.classes())
+            {
+                references.push_back(intern(cl));
+            }
+
+            for (const auto& param : element.params())
+            {
+                references.push_back(intern(param.first));
+                references.push_back(intern(param.second));
+            }
+
+            elements.push_back(compiled);
+            ++record.elementCount;
+        }
+
+        for (auto itr = fragment.block().cbegin(); itr != fragment.block().cend(); ++itr)
+        {
+            properties.push_back(PropertyRecord{ intern(itr->first), intern(itr->second.first), itr->second.second ? 1u : 0u });
+            ++record.propertyCount;
+        }
+
+        fragments.push_back(record);
+    }
+
+    header.fragments = static_cast<quint32>(fragments.size());
+    header.elements = static_cast<quint32>(elements.size());
+    header.properties = static_cast<quint32>(properties.size());
+    header.references = static_cast<quint32>(references.size());
+    header.strings = static_cast<quint32>(strings.size());
+    header.characters = static_cast<quint32>(characters.size());
+
+    QByteArray result;
+    result.reserve(static_cast<qsizetype>(sizeof(Header) + fragments.size() * sizeof(FragmentRecord) +
+        elements.size() * sizeof(ElementRecord) + properties.size() * sizeof(PropertyRecord) +
+        references.size() * sizeof(quint32) + strings.size() * sizeof(StringRecord) + characters.size() * sizeof(char16_t)));
+    result.append(reinterpret_cast<const char*>(&header), sizeof(Header));
+    Append(result, fragments);
+    Append(result, elements);
+    Append(result, properties);
+    Append(result, references);
+    Append(result, strings);
+    result.append(reinterpret_cast<const char*>(characters.utf16()), characters.size() * static_cast<qsizetype>(sizeof(char16_t)));
+    return result;
+}
+
+void qss::CompiledDocument::save(const Document& document, const QString& path)
+{
+    QFile file{ path };
+    const auto data = compile(document);
+
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+    {
+        throw Exception{ Exception::FILE_UNWRITABLE, path };
+    }
+}
+
+qss::Document qss::CompiledDocument::toDocument() const
+{
+    // Appended as stored: repeated selectors stay separate fragments, as
+    // they were in the compiled document
+    Document document;
+
+    for (std::size_t i = 0; i < totalFragments(); ++i)
+    {
+        const auto fragment = (*this)[i];
+        document.m_fragments.emplace_back(fragment.toFragment(), fragment.isEnabled());
+    }
+
+    document.reindex();
+
+    return document;
+}
+
+void qss::CompiledDocument::load(const uchar* data, qsizetype size)
+{
+    // Every offset is checked once here, so the views can index without checks
+    auto invalid = [](const QString& details) {
+        return Exception{ Exception::COMPILED_INVALID, details };
+    };
+
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(quint32) != 0)
+    {
+        throw invalid("misaligned data");
+    }
+
+    if (size < static_cast<qsizetype>(sizeof(Header)))
+    {
+        throw invalid("truncated header");
+    }
+
+    const auto* header = reinterpret_cast<const Header*>(data);
+
+    // The magic reads byte-swapped in a file written with the other byte
+    // order, and its version is then garbage, so it is checked first
+    constexpr quint32 Swapped = (Magic >> 24) | ((Magic >> 8) & 0xff00) | ((Magic << 8) & 0xff0000) | (Magic << 24);
+
+    if (header->magic == Swapped)
+    {
+        throw invalid("foreign byte order");
+    }
+
+    if (header->magic != Magic)
+    {
+        throw invalid("bad magic");
+    }
+
+    if (header->version != Version)
+    {
+        throw invalid(QString{ "version %1" }.arg(QString::number(static_cast<qint64>(header->version))));
+    }
+
+    const quint64 required = sizeof(Header) + quint64{ header->fragments } * sizeof(FragmentRecord) +
+        quint64{ header->elements } * sizeof(ElementRecord) + quint64{ header->properties } * sizeof(PropertyRecord) +
+        quint64{ header->references } * sizeof(quint32) + quint64{ header->strings } * sizeof(StringRecord) +
+        quint64{ header->characters } * sizeof(char16_t);
+
+    if (required > static_cast<quint64>(size) || header->strings == 0)
+    {
+        throw invalid("truncated tables");
+    }
+
+    auto cursor = data + sizeof(Header);
+    m_fragments = reinterpret_cast<const FragmentRecord*>(cursor);
+    cursor += header->fragments * sizeof(FragmentRecord);
+    m_elements = reinterpret_cast<const ElementRecord*>(cursor);
+    cursor += header->elements * sizeof(ElementRecord);
+    m_properties = reinterpret_cast<const PropertyRecord*>(cursor);
+    cursor += header->properties * sizeof(PropertyRecord);
+    m_references = reinterpret_cast<const quint32*>(cursor);
+    cursor += header->references * sizeof(quint32);
+    m_strings = reinterpret_cast<const StringRecord*>(cursor);
+    cursor += header->strings * sizeof(StringRecord);
+    m_characters = reinterpret_cast<const char16_t*>(cursor);
+
+    for (quint32 i = 0; i < header->strings; ++i)
+    {
+        if (quint64{ m_strings[i].offset } + m_strings[i].length > header->characters)
+        {
+            throw invalid(QString{ "string %1" }.arg(QString::number(static_cast<qint64>(i))));
+        }
+    }
+
+    auto isString = [header](quint32 index) { return index < header->strings; };
+
+    for (quint32 i = 0; i < header->references; ++i)
+    {
+        if (!isString(m_references[i]))
+        {
+            throw invalid(QString{ "reference %1" }.arg(QString::number(static_cast<qint64>(i))));
+        }
+    }
+
+    for (quint32 i = 0; i < header->elements; ++i)
+    {
+        const auto& element = m_elements[i];
+
+        if (element.position > SelectorElement::GENERAL_SIBLING || !isString(element.name) || !isString(element.id) ||
+            !isString(element.subControl) || !isString(element.psuedoClass) ||
+            quint64{ element.firstReference } + element.classCount + 2 * quint64{ element.paramCount } > header->references)
+        {
+            throw invalid(QString{ "element %1" }.arg(QString::number(static_cast<qint64>(i))));
+        }
+    }
+
+    for (quint32 i = 0; i < header->properties; ++i)
+    {
+        if (!isString(m_properties[i].key) || !isString(m_properties[i].value))
+        {
+            throw invalid(QString{ "property %1" }.arg(QString::number(static_cast<qint64>(i))));
+        }
+    }
+
+    for (quint32 i = 0; i < header->fragments; ++i)
+    {
+        const auto& fragment = m_fragments[i];
+
+        if (quint64{ fragment.firstElement } + fragment.elementCount > header->elements ||
+            quint64{ fragment.firstProperty } + fragment.propertyCount > header->properties)
+        {
+            throw invalid(QString{ "fragment %1" }.arg(QString::number(static_cast<qint64>(i))));
+        }
+    }
+
+    m_header = header;
+}
@@ -1,29 +1,215 @@
 #include "../include/qssdocument.h"
+#include "../include/qsswriter.h"
+
+#include <QSemaphore>
 
 #include <algorithm>
-#include <regex>
+#include <atomic>
+#include <exception>
+#include <iterator>
+
+namespace
+{
+    typedef std::pmr::deque<qss::Document::QSSFragmentPair> Fragments;
+
+    // Replaces the container, resource included, which assignment never does
+    void Rebuild(Fragments& fragments, Fragments&& from = Fragments{})
+    {
+        fragments.~Fragments();
+        new (&fragments) Fragments{ std::move(from) };
+    }
+}
 
 qss::Document::Document(const QString &qss)
 {
-    std::regex regRemoveComments(R"((//.*?$|/\*[\S\s]*?\*/)|(\'(?:\\.|[^\\\'])*\'|"(?:\\.|[^\\"])*"))");
+    parse(qss);
+}
 
-    std::string str = qss.toStdString();
-    std::string strNoComments = std::regex_replace(str, regRemoveComments, "$2");
-    std::replace(strNoComments.begin(), strNoComments.end(), '\n', ' ');
+qss::Document::Document(const Document &document)
+    : m_fragments{ document.m_fragments, Allocator{} }, m_generation{ document.m_generation },
+      m_index{ document.m_index }, m_indexed{ document.m_indexed }, m_source{ document.m_source },
+      m_ends{ document.m_ends }, m_editable{ document.m_editable }
+{
+}
 
-    QString qssNoComments = QString::fromStdString(strNoComments);
-    parse(qssNoComments);
+qss::Document::Document(Document &&document)
+    : m_arena{ std::move(document.m_arena) }, m_fragments{ std::move(document.m_fragments) },
+      m_generation{ document.m_generation }, m_index{ std::move(document.m_index) }, m_indexed{ document.m_indexed },
+      m_source{ std::move(document.m_source) }, m_ends{ std::move(document.m_ends) }, m_editable{ document.m_editable }
+{
+    // A moved from deque may keep a fresh map from the resource, which
+    // must not outlive the arena that now belongs to this document
+    if (m_arena)
+    {
+        Rebuild(document.m_fragments);
+    }
+
+    // The moved from document no longer holds what caches bound to it remember
+    document.m_generation = nextGeneration();
+    document.m_index.clear();
+    document.m_indexed = true;
+    document.m_editable = false;
+}
+
+qss::Document& qss::Document::operator=(const Document &document)
+{
+    // The fragments are copied into this document's own resource
+    m_fragments = document.m_fragments;
+    m_generation = document.m_generation;
+    m_index = document.m_index;
+    m_indexed = document.m_indexed;
+    m_source = document.m_source;
+    m_ends = document.m_ends;
+    m_editable = document.m_editable;
+    return *this;
+}
+
+qss::Document& qss::Document::operator=(Document &&document)
+{
+    if (this == &document)
+    {
+        return *this;
+    }
+
+    const auto shared = m_fragments.get_allocator() == document.m_fragments.get_allocator();
+
+    if (shared)
+    {
+        m_fragments = std::move(document.m_fragments);
+    }
+    else
+    {
+        // pmr containers keep their resource on assignment and would copy
+        // the fragments over. Taking the other resource along instead lets
+        // the old fragments go first and their arena with them, below.
+        Rebuild(m_fragments, std::move(document.m_fragments));
+    }
+
+    if (document.m_arena)
+    {
+        Rebuild(document.m_fragments);
+        m_arena = std::move(document.m_arena);
+    }
+    else if (!shared)
+    {
+        m_arena.reset();
+    }
+
+    m_generation = document.m_generation;
+    m_index = std::move(document.m_index);
+    m_indexed = document.m_indexed;
+    m_source = std::move(document.m_source);
+    m_ends = std::move(document.m_ends);
+    m_editable = document.m_editable;
+    document.m_generation = nextGeneration();
+    document.m_index.clear();
+    document.m_indexed = true;
+    document.m_editable = false;
+    return *this;
+}
+
+qss::Document qss::Document::withArena(std::size_t initialSize)
+{
+    auto arena = std::make_shared<std::pmr::monotonic_buffer_resource>(initialSize);
+    Document document{ arena.get() };
+    document.m_arena = std::move(arena);
+    return document;
+}
+
+qss::Document qss::Document::fromFile(const QString &path)
+{
+    QFile file{ path };
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        throw Exception{ Exception::FILE_UNREADABLE, path };
+    }
+
+    Document document;
+
+    if (file.size() > 0)
+    {
+        // A private mapping is writable without touching the file, so the
+        // UTF-8 bytes are lexed in place and only pages that a stripped
+        // comment shifts are ever copied
+        auto data = file.map(0, file.size(), QFileDevice::MapPrivateOption);
+
+        if (data == nullptr)
+        {
+            // Compressed resources and some devices cannot be mapped
+            return fromUtf8(file.readAll());
+        }
+
+        Utf8Lexer lexer;
+        lexer.lex(reinterpret_cast<char*>(data), file.size());
+        lexer.finish();
+        document.parse(lexer);
+        file.unmap(data);
+    }
+
+    return document;
+}
+
+qss::Document qss::Document::fromUtf8(QByteArrayView utf8)
+{
+    Utf8Lexer lexer;
+    lexer.feed(utf8);
+    lexer.finish();
+
+    Document document;
+    document.parse(lexer);
+    return document;
+}
+
+qss::Document qss::Document::fromFile(const QString &path, Diagnostics &diagnostics)
+{
+    QFile file{ path };
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        throw Exception{ Exception::FILE_UNREADABLE, path };
+    }
+
+    // Locating problems needs the text as it was, so the mapping is only
+    // read and the lexer works on a copy
+    auto data = file.size() > 0 ? file.map(0, file.size()) : nullptr;
+
+    if (data == nullptr)
+    {
+        return fromUtf8(file.readAll(), diagnostics);
+    }
+
+    auto document = fromUtf8(QByteArrayView{ reinterpret_cast<const char*>(data), file.size() }, diagnostics);
+    file.unmap(data);
+    return document;
+}
+
+qss::Document qss::Document::fromUtf8(QByteArrayView utf8, Diagnostics &diagnostics)
+{
+    Diagnostics found;
+    Utf8Lexer lexer{ Utf8Lexer::DOCUMENT, &found };
+    lexer.feed(utf8);
+    lexer.finish();
+
+    Document document;
+    document.append(lexer, &found);
+    locate(found, utf8);
+    diagnostics.insert(diagnostics.end(), found.cbegin(), found.cend());
+    return document;
 }
 
 qss::Document& qss::Document::addFragment(const Fragment& fragment, bool enabled)
 {
+    m_generation = nextGeneration();
+    m_editable = false;
+    auto& positions = selectorIndex()[fragment.selector().hash()];
     auto selectorExists = false;
 
-    for (auto& frags : m_fragments)
+    for (auto position : positions)
     {
-        if (frags.first.selector() == fragment.selector())
+        if (m_fragments[position].first.selector() == fragment.selector())
         {
-            frags.first.addBlock(fragment.block());
+            m_fragments[position].first.addBlock(fragment.block());
             selectorExists = true;
         }
     }
@@ -31,42 +217,127 @@ qss::Document& qss::Document::addFragment(const Fragment& fragment, bool enabled
     if (!selectorExists)
     {
         m_fragments.push_back(std::make_pair(fragment, enabled));
+        positions.push_back(m_fragments.size() - 1);
+    }
+
+    return *this;
+}
+
+qss::Document& qss::Document::addFragment(Fragment&& fragment, bool enabled)
+{
+    m_generation = nextGeneration();
+    m_editable = false;
+    auto& positions = selectorIndex()[fragment.selector().hash()];
+
+    if (!merge(positions, std::move(fragment)))
+    {
+        m_fragments.emplace_back(std::move(fragment), enabled);
+        positions.push_back(m_fragments.size() - 1);
     }
 
     return *this;
 }
 
+bool qss::Document::merge(const std::vector<std::size_t>& positions, Fragment&& fragment)
+{
+    // Every fragment with the selector gets the block, as in addFragment,
+    // and only the last one takes it over instead of copying
+    auto last = m_fragments.size();
+
+    for (auto position : positions)
+    {
+        if (m_fragments[position].first.selector() == fragment.selector())
+        {
+            if (last != m_fragments.size())
+            {
+                m_fragments[last].first.addBlock(fragment.block());
+            }
+
+            last = position;
+        }
+    }
+
+    if (last == m_fragments.size())
+    {
+        return false;
+    }
+
+    m_fragments[last].first.addBlock(std::move(fragment.block()));
+    return true;
+}
+
+// The index is current up to the fragment before the last one
+void qss::Document::mergeLast()
+{
+    m_generation = nextGeneration();
+    m_editable = false;
+    auto& positions = m_index[m_fragments.back().first.selector().hash()];
+
+    if (merge(positions, std::move(m_fragments.back().first)))
+    {
+        m_fragments.pop_back();
+    }
+    else
+    {
+        positions.push_back(m_fragments.size() - 1);
+    }
+}
+
 qss::Document& qss::Document::toggleFragment(int index)
 {
+    m_generation = nextGeneration();
     m_fragments[index].second = !m_fragments[index].second;
     return *this;
 }
 
 qss::Document& qss::Document::addFragment(const QString& fragment, bool enabled)
 {
-    return addFragment(Fragment{ fragment }, enabled);
+    return addFragment(Fragment{ fragment, m_fragments.get_allocator() }, enabled);
 }
 
 qss::Document& qss::Document::enableFragment(int index, bool enable)
 {
+    m_generation = nextGeneration();
     m_fragments[index].second = enable;
     return *this;
 }
 
 qss::Document& qss::Document::removeFragment(const QString& fragment)
 {
-    std::remove_if(m_fragments.begin(), m_fragments.end(), [fragment](const QSSFragmentPair& existing){
-        return QString::compare(existing.first.toString(), Fragment{ fragment }.toString()) == 0;
+    const Fragment key{ fragment };
+    const auto hash = key.hash();
+
+    return removeIf([&key, hash](const QSSFragmentPair& existing){
+        return existing.first.hash() == hash && existing.first == key;
     });
-    return *this;
 }
 
 qss::Document& qss::Document::removeFragment(int index)
 {
+    m_generation = nextGeneration();
+    m_editable = false;
     m_fragments.erase(m_fragments.begin() + index);
+    reindex();
     return *this;
 }
 
+qss::Document& qss::Document::removeFragments(const QStringList& selectors)
+{
+    std::unordered_map<quint64, std::vector<Selector>> keys;
+
+    for (const auto& selector : selectors)
+    {
+        Selector key{ selector };
+        keys[key.hash()].push_back(std::move(key));
+    }
+
+    return removeIf([&keys](const QSSFragmentPair& existing){
+        const auto& selector = existing.first.selector();
+        auto itr = keys.find(selector.hash());
+        return itr != keys.cend() && std::find(itr->second.cbegin(), itr->second.cend(), selector) != itr->second.cend();
+    });
+}
+
 qss::Document& qss::Document::operator+=(const QString& fragment)
 {
     addFragment(fragment, true);
@@ -83,6 +354,26 @@ qss::Document& qss::Document::operator+=(const Document & qss)
     return *this;
 }
 
+qss::Document& qss::Document::operator+=(Document && qss)
+{
+    if (this == &qss)
+    {
+        return *this += static_cast<const Document&>(qss);
+    }
+
+    for (auto& fragment : qss.m_fragments)
+    {
+        addFragment(std::move(fragment.first), true);
+    }
+
+    qss.m_fragments.clear();
+    qss.m_generation = nextGeneration();
+    qss.m_index.clear();
+    qss.m_indexed = true;
+    qss.m_editable = false;
+    return *this;
+}
+
 qss::Document qss::Document::inheritable(const QString & input) const
 {
     Document qss;
@@ -106,7 +397,7 @@ qss::Document qss::Document::inheritable(const QString & input) const
             qss.addFragment(fragment);
         }
 
-        if (fragment.selector().fragmentCount() <= 2)
+        if (fselect.fragmentCount() == 2)
         {
             if (fragment.selector()[1].toString() == selector)
             {
@@ -121,46 +412,532 @@ qss::Document qss::Document::inheritable(const QString & input) const
     return qss;
 }
 
-void qss::Document::parse(const QString& input)
+std::vector<std::size_t> qss::Document::find(const QString& selector) const
+{
+    const Selector key{ selector };
+    std::vector<std::size_t> result;
+
+    if (!m_indexed)
+    {
+        for (std::size_t i = 0; i < m_fragments.size(); ++i)
+        {
+            if (m_fragments[i].first.selector() == key)
+            {
+                result.push_back(i);
+            }
+        }
+
+        return result;
+    }
+
+    auto itr = m_index.find(key.hash());
+
+    if (itr != m_index.cend())
+    {
+        std::copy_if(itr->second.cbegin(), itr->second.cend(), std::back_inserter(result), [this, &key](std::size_t position) {
+            return m_fragments[position].first.selector() == key;
+        });
+    }
+
+    return result;
+}
+
+QString qss::Document::value(const QString& selector, const QString& key) const
 {
-    auto insideStr = false;
-    QString fragment;
+    // The last enabled declaration wins, as in the cascade
+    auto positions = find(selector);
 
-    for (auto i = 0; i < input.size(); ++i)
+    for (auto itr = positions.crbegin(); itr != positions.crend(); ++itr)
     {
-        fragment += input.at(i);
+        const auto& pair = m_fragments[*itr];
+        const auto* value = pair.first.block().typedValue(key);
 
-        if (input.at(i) == '"')
+        if (pair.second && value != nullptr)
         {
-            insideStr = !insideStr;
+            return value->toString();
         }
+    }
 
-        if (insideStr)
-            continue;
-        else
+    return QString{};
+}
+
+qss::Document::FragmentRange qss::Document::edit(qsizetype position, qsizetype removed, const QString& inserted)
+{
+    if (!m_editable || position < 0 || removed < 0 || position + removed > m_source.size())
+    {
+        throw Exception{ Exception::EDIT_INVALID, QString{ "%1, %2" }.arg(QString::number(position)).arg(QString::number(removed)) };
+    }
+
+    const auto delta = inserted.size() - removed;
+
+    // Fragments that end before the edit are kept as they are, and lexing
+    // starts at the boundary before the first one it touches, where the lexer
+    // is known to be outside any comment, string or block
+    const auto first = m_ends.upperBound(position);
+    const auto begin = first == 0 ? 0 : m_ends.end(first - 1);
+    auto last = std::max(first, m_ends.lowerBound(position + removed));
+
+    // The source is spliced in place and put back if lexing or parsing
+    // throws, so a failed edit leaves the document as it was
+    const auto original = m_source.mid(position, removed);
+    m_source.replace(position, removed, inserted);
+
+    Lexer lexer;
+    std::vector<Fragment> fragments;
+    std::vector<qsizetype> lengths;
+
+    try
+    {
+        // Past the edit the text is unchanged, so once a fragment closes
+        // exactly where an old one closed the rest lexes as before. Old
+        // boundaries are tried one at a time until that happens.
+        auto fed = begin;
+        auto synced = false;
+
+        for (; last < m_ends.size() && !synced; ++last)
+        {
+            const auto end = m_ends.end(last) + delta;
+            lexer.feed(QStringView{ m_source }.mid(fed, end - fed));
+            fed = end;
+
+            const auto& tokens = lexer.tokens();
+            synced = !tokens.empty() && begin + tokens.back().source.begin + tokens.back().source.length == end;
+        }
+
+        if (!synced)
+        {
+            lexer.feed(QStringView{ m_source }.mid(fed));
+            lexer.finish();
+        }
+
+        const auto& tokens = lexer.tokens();
+        fragments.resize(tokens.size());
+        lengths.resize(tokens.size());
+        auto previous = begin;
+
+        for (std::size_t i = 0; i < tokens.size(); ++i)
+        {
+            fragments[i].parse(lexer, tokens[i]);
+            const auto end = begin + tokens[i].source.begin + tokens[i].source.length;
+            lengths[i] = end - previous;
+            previous = end;
+        }
+    }
+    catch (...)
+    {
+        m_source.replace(position, inserted.size(), original);
+        throw;
+    }
+
+    // Fragments that parse the same as before, e.g. after an edit to
+    // whitespace or a comment, keep their state and are not reported
+    std::size_t prefix = 0;
+    std::size_t suffix = 0;
+
+    while (first + prefix < last && prefix < fragments.size() && m_fragments[first + prefix].first == fragments[prefix])
+    {
+        ++prefix;
+    }
+
+    while (first + prefix + suffix < last && prefix + suffix < fragments.size() &&
+        m_fragments[last - suffix - 1].first == fragments[fragments.size() - suffix - 1])
+    {
+        ++suffix;
+    }
+
+    FragmentRange range{ first + prefix, last - suffix - first - prefix, fragments.size() - suffix - prefix };
+    const auto replaced = std::min(range.removed, range.inserted);
+    const auto at = m_fragments.begin() + range.first;
+
+    // A fragment replaced in place keeps its enabled state and, while no
+    // position shifts, only its own index entries move
+    const auto shifted = range.removed != range.inserted;
+
+    for (std::size_t i = 0; i < replaced; ++i)
+    {
+        const auto index = range.first + i;
+
+        if (!shifted && m_indexed)
         {
-            if (input.at(i) == Delimiters.at(QSS_BLOCK_END_DELIMITER))
+            const auto hash = at[i].first.selector().hash();
+            auto& positions = m_index[hash];
+            positions.erase(std::find(positions.begin(), positions.end(), index));
+
+            if (positions.empty())
             {
-                m_fragments.emplace_back(std::make_pair(fragment, true));
-                fragment.clear();
+                m_index.erase(hash);
             }
         }
+
+        at[i].first = std::move(fragments[prefix + i]);
+
+        if (!shifted && m_indexed)
+        {
+            auto& positions = m_index[at[i].first.selector().hash()];
+            positions.insert(std::lower_bound(positions.begin(), positions.end(), index), index);
+        }
+    }
+
+    if (range.removed > replaced)
+    {
+        m_fragments.erase(at + replaced, at + range.removed);
     }
+    else if (range.inserted > replaced)
+    {
+        std::vector<QSSFragmentPair> added;
+        added.reserve(range.inserted - replaced);
+
+        for (auto i = prefix + replaced; i < prefix + range.inserted; ++i)
+        {
+            added.emplace_back(std::move(fragments[i]), true);
+        }
+
+        m_fragments.insert(at + replaced, std::make_move_iterator(added.begin()), std::make_move_iterator(added.end()));
+    }
+
+    // Once lexing synced, the fragment after the last one re-lexed starts
+    // where it used to and keeps its length
+    m_ends.replace(first, last, lengths);
+
+    if (range.removed > 0 || range.inserted > 0)
+    {
+        m_generation = nextGeneration();
+
+        if (shifted || !m_indexed)
+        {
+            reindex();
+        }
+    }
+
+    return range;
 }
 
-QString qss::Document::toString() const
+void qss::Document::track(const QString& source, const Lexer& lexer)
 {
-    QString result;
+    m_source = source;
+    std::vector<qsizetype> lengths;
+    lengths.reserve(lexer.tokens().size());
+    qsizetype previous = 0;
 
-    for (const auto& pair : m_fragments)
+    for (const auto& token : lexer.tokens())
+    {
+        lengths.push_back(token.source.begin + token.source.length - previous);
+        previous += lengths.back();
+    }
+
+    m_ends.assign(std::move(lengths));
+    m_editable = true;
+}
+
+void qss::Document::Ends::assign(std::vector<qsizetype>&& lengths)
+{
+    m_lengths = std::move(lengths);
+    build();
+}
+
+// Lengths [first, last) become the given ones. The same number of them is
+// updated in the tree in place, any other rebuilds it.
+void qss::Document::Ends::replace(std::size_t first, std::size_t last, const std::vector<qsizetype>& lengths)
+{
+    if (last - first != lengths.size())
+    {
+        m_lengths.erase(m_lengths.begin() + first, m_lengths.begin() + last);
+        m_lengths.insert(m_lengths.begin() + first, lengths.cbegin(), lengths.cend());
+        build();
+        return;
+    }
+
+    for (std::size_t i = 0; i < lengths.size(); ++i)
     {
-        if (pair.second)
+        const auto change = lengths[i] - m_lengths[first + i];
+        m_lengths[first + i] = lengths[i];
+
+        for (auto node = first + i + 1; change != 0 && node < m_tree.size(); node += node & (~node + 1))
         {
-            result += pair.first.toString() + "\n";
+            m_tree[node] += change;
         }
     }
+}
 
-    return result;
+qsizetype qss::Document::Ends::end(std::size_t index) const
+{
+    qsizetype sum = 0;
+
+    for (auto node = index + 1; node > 0; node &= node - 1)
+    {
+        sum += m_tree[node];
+    }
+
+    return sum;
+}
+
+// The first fragment ending after position
+std::size_t qss::Document::Ends::upperBound(qsizetype position) const
+{
+    return search(position, true);
+}
+
+// The first fragment ending at or after position
+std::size_t qss::Document::Ends::lowerBound(qsizetype position) const
+{
+    return search(position, false);
+}
+
+void qss::Document::Ends::build()
+{
+    m_tree.assign(m_lengths.size() + 1, 0);
+
+    for (std::size_t node = 1; node < m_tree.size(); ++node)
+    {
+        m_tree[node] += m_lengths[node - 1];
+        const auto parent = node + (node & (~node + 1));
+
+        if (parent < m_tree.size())
+        {
+            m_tree[parent] += m_tree[node];
+        }
+    }
+}
+
+// Descends the tree, skipping every block of fragments that ends before
+// position, or at it when inclusive. Lengths are never negative.
+std::size_t qss::Document::Ends::search(qsizetype position, bool inclusive) const
+{
+    std::size_t node = 0;
+    qsizetype sum = 0;
+    std::size_t step = 1;
+
+    while (step * 2 < m_tree.size())
+    {
+        step *= 2;
+    }
+
+    for (; step > 0; step /= 2)
+    {
+        const auto next = node + step;
+
+        if (next < m_tree.size() && (inclusive ? sum + m_tree[next] <= position : sum + m_tree[next] < position))
+        {
+            node = next;
+            sum += m_tree[next];
+        }
+    }
+
+    return node;
+}
+
+void qss::Document::reindex()
+{
+    m_index.clear();
+    m_index.reserve(m_fragments.size());
+
+    for (std::size_t i = 0; i < m_fragments.size(); ++i)
+    {
+        m_index[m_fragments[i].first.selector().hash()].push_back(i);
+    }
+
+    m_indexed = true;
+}
+
+qss::Document::SelectorIndex& qss::Document::selectorIndex()
+{
+    if (!m_indexed)
+    {
+        reindex();
+    }
+
+    return m_index;
+}
+
+void qss::Document::parse(const QString& input)
+{
+    const auto empty = m_fragments.empty();
+    Lexer lexer;
+    lexer.feed(input);
+    lexer.finish();
+    parse(lexer);
+
+    if (empty)
+    {
+        track(input, lexer);
+    }
+}
+
+void qss::Document::parse(const QString& input, Diagnostics& diagnostics)
+{
+    Diagnostics found;
+    Lexer lexer{ Lexer::DOCUMENT, &found };
+    lexer.feed(input);
+    lexer.finish();
+    append(lexer, &found);
+    locate(found, input);
+    diagnostics.insert(diagnostics.end(), found.cbegin(), found.cend());
+}
+
+template <typename L>
+void qss::Document::append(const L& lexer, Diagnostics* diagnostics)
+{
+    m_generation = nextGeneration();
+    m_editable = false;
+    auto& index = selectorIndex();
+
+    for (const auto& token : lexer.tokens())
+    {
+        // Parsed in place, so everything it holds comes from the document's resource
+        auto& fragment = m_fragments.emplace_back(std::piecewise_construct, std::forward_as_tuple(), std::forward_as_tuple(true)).first;
+        auto parsed = true;
+        auto error = 0;
+
+        try
+        {
+            if (diagnostics == nullptr)
+            {
+                fragment.parse(lexer, token);
+            }
+            else
+            {
+                parsed = fragment.parse(lexer, token, error);
+            }
+        }
+        catch (...)
+        {
+            m_fragments.pop_back();
+            throw;
+        }
+
+        if (!parsed)
+        {
+            m_fragments.pop_back();
+            diagnostics->push_back(Diagnostic{ error, token.source.begin });
+        }
+        else
+        {
+            index[fragment.selector().hash()].push_back(m_fragments.size() - 1);
+        }
+    }
+}
+
+void qss::Document::parse(const Utf8Lexer& lexer)
+{
+    append(lexer, nullptr);
+}
+
+void qss::Document::parse(const Lexer& lexer)
+{
+    append(lexer, nullptr);
+}
+
+void qss::Document::parse(const QString& input, QThreadPool* pool)
+{
+    const auto empty = m_fragments.empty();
+    Lexer lexer;
+    lexer.feed(input);
+    lexer.finish();
+    parse(lexer, pool);
+
+    if (empty)
+    {
+        track(input, lexer);
+    }
+}
+
+void qss::Document::parse(const Lexer& lexer, QThreadPool* pool)
+{
+    m_generation = nextGeneration();
+    m_editable = false;
+    const auto& tokens = lexer.tokens();
+    const auto total = tokens.size();
+    const auto threads = static_cast<std::size_t>(std::max(1, pool ? pool->maxThreadCount() : 1));
+
+    // Fragment boundaries are already known, so contiguous runs of tokens are
+    // parsed independently and appended afterwards in source order. A few
+    // runs per thread even out fragments of very different sizes.
+    const auto runs = std::min(total, threads * 4);
+
+    if (pool == nullptr || runs <= 1)
+    {
+        parse(lexer);
+        return;
+    }
+
+    std::vector<Fragment> fragments(total);
+    std::vector<std::exception_ptr> errors(runs);
+    std::vector<std::size_t> failed(runs, total);
+
+    auto parseRun = [&](std::size_t run)
+    {
+        const auto begin = total * run / runs;
+        const auto end = total * (run + 1) / runs;
+
+        for (auto i = begin; i < end; ++i)
+        {
+            try
+            {
+                fragments[i].parse(lexer, tokens[i]);
+            }
+            catch (...)
+            {
+                errors[run] = std::current_exception();
+                failed[run] = i;
+                return;
+            }
+        }
+    };
+
+    // The calling thread and every worker that gets to start claim runs
+    // from a shared counter until none are left, so the caller only waits
+    // for runs a worker is already parsing, never for a task queued behind
+    // it on a busy pool. A worker starting after the last claim touches only
+    // the counter and semaphore, which it keeps alive.
+    struct Progress
+    {
+        std::atomic<std::size_t> next{ 0 };
+        QSemaphore               done;
+    };
+
+    auto progress = std::make_shared<Progress>();
+
+    for (std::size_t worker = 1; worker < std::min(threads, runs); ++worker)
+    {
+        pool->start([progress, &parseRun, runs]() {
+            for (auto run = progress->next++; run < runs; run = progress->next++)
+            {
+                parseRun(run);
+                progress->done.release();
+            }
+        });
+    }
+
+    std::size_t parsed = 0;
+
+    for (auto run = progress->next++; run < runs; run = progress->next++)
+    {
+        parseRun(run);
+        ++parsed;
+    }
+
+    progress->done.acquire(static_cast<int>(runs - parsed));
+
+    // Match the serial parse on failure: fragments before the first bad one
+    // are kept and its exception is rethrown
+    auto first = std::min_element(failed.cbegin(), failed.cend());
+    auto& index = selectorIndex();
+
+    for (std::size_t i = 0; i < *first; ++i)
+    {
+        index[fragments[i].selector().hash()].push_back(m_fragments.size());
+        m_fragments.emplace_back(std::move(fragments[i]), true);
+    }
+
+    if (*first != total)
+    {
+        std::rethrow_exception(errors[first - failed.cbegin()]);
+    }
+}
+
+QString qss::Document::toString() const
+{
+    return Writer::toString(*this);
 }
 
 std::size_t qss::Document::totalActiveFragments() const
@@ -176,3 +953,9 @@ qss::Document qss::operator+(const Document & lhs, const Document & rhs)
     sum += rhs;
     return sum;
 }
+
+qss::Document qss::operator+(Document && lhs, const Document & rhs)
+{
+    lhs += rhs;
+    return std::move(lhs);
+}
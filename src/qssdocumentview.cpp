@@ -0,0 +1,44 @@
+#include "../include/qssdocumentview.h"
+
+QStringView qss::FragmentView::value(QStringView key) const
+{
+    // Later declarations override earlier ones, as in PropertyBlock
+    for (auto i = m_token->declarationCount; i > 0; --i)
+    {
+        const auto& declaration = m_lexer->declaration(*m_token, i - 1);
+
+        if (m_lexer->text(declaration.key) == key)
+        {
+            return m_lexer->text(declaration.value);
+        }
+    }
+
+    return QStringView{};
+}
+
+qss::PropertyView qss::FragmentView::operator[](std::size_t index) const
+{
+    const auto& declaration = m_lexer->declaration(*m_token, static_cast<qsizetype>(index));
+    return PropertyView{ m_lexer->text(declaration.key), m_lexer->text(declaration.value) };
+}
+
+qss::Fragment qss::FragmentView::toFragment() const
+{
+    Fragment fragment;
+    fragment.parse(*m_lexer, *m_token);
+    return fragment;
+}
+
+void qss::DocumentView::parse(const QString& qss)
+{
+    m_lexer.reset();
+    m_lexer.feed(qss);
+    m_lexer.finish();
+}
+
+qss::Document qss::DocumentView::toDocument() const
+{
+    Document document;
+    document.parse(m_lexer);
+    return document;
+}
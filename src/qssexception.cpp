@@ -1,4 +1,67 @@
 #include "../include/qssexception.h"
+#include "../include/qsslexer.h"
+
+#include <algorithm>
+
+namespace
+{
+    template <typename Char>
+    void Locate(qss::Diagnostics& diagnostics, typename qss::LexerTraits<Char>::View input)
+    {
+        typedef qss::LexerTraits<Char> Traits;
+        const auto size = input.size();
+        auto at = [&input, size](qsizetype i) -> char16_t { return i < size ? Traits::unit(input[i]) : 0; };
+
+        // Fragments and declarations are reported where the previous one
+        // ended, so the spaces and comments in between are stepped over
+        for (auto& diagnostic : diagnostics)
+        {
+            auto i = std::clamp<qsizetype>(diagnostic.offset, 0, size);
+
+            while (i < size)
+            {
+                if (Traits::isSpace(input[i]))
+                {
+                    ++i;
+                }
+                else if (at(i) == '/' && at(i + 1) == '*')
+                {
+                    for (i += 2; i < size && !(at(i) == '*' && at(i + 1) == '/'); ++i) {}
+                    i = std::min(i + 2, size);
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            diagnostic.offset = i;
+        }
+
+        std::stable_sort(diagnostics.begin(), diagnostics.end(), [](const qss::Diagnostic& lhs, const qss::Diagnostic& rhs) {
+            return lhs.offset < rhs.offset;
+        });
+
+        int line = 1;
+        qsizetype lineStart = 0;
+        qsizetype i = 0;
+
+        for (auto& diagnostic : diagnostics)
+        {
+            for (; i < diagnostic.offset; ++i)
+            {
+                if (at(i) == '\n')
+                {
+                    ++line;
+                    lineStart = i + 1;
+                }
+            }
+
+            diagnostic.line = line;
+            diagnostic.column = static_cast<int>(diagnostic.offset - lineStart + 1);
+        }
+    }
+}
 
 const std::unordered_map<int, QString> qss::Exception::Messages {
     { Exception::HEADER_PARAM_INVALID, "Header param is invalid" },
@@ -6,10 +69,35 @@ const std::unordered_map<int, QString> qss::Exception::Messages {
     { Exception::SELECTOR_INVALID, "Selector is invalid" },
     { Exception::BLOCK_BRACKETS_INVALID, "Block brackets invalid" },
     { Exception::MULTIPLE_IDS, "More than one id encountered" },
-    { Exception::ILL_FORMED_HEADER_PARAM, "Header param is incomplete" }
+    { Exception::ILL_FORMED_HEADER_PARAM, "Header param is incomplete" },
+    { Exception::FILE_UNREADABLE, "File could not be read" },
+    { Exception::EDIT_INVALID, "Edit does not apply to the document source" },
+    { Exception::FILE_UNWRITABLE, "File could not be written" },
+    { Exception::COMPILED_INVALID, "Compiled stylesheet is invalid" }
 };
 
 QString qss::Exception::what() const
 {
     return QString{ Messages.at(m_code) + ": < %1 >" }.arg(m_details);
 }
+
+bool qss::Exception::raise(int* error, int code, const QString& details)
+{
+    if (error == nullptr)
+    {
+        throw Exception{ code, details };
+    }
+
+    *error = code;
+    return false;
+}
+
+void qss::locate(Diagnostics& diagnostics, QStringView input)
+{
+    Locate<QChar>(diagnostics, input);
+}
+
+void qss::locate(Diagnostics& diagnostics, QByteArrayView input)
+{
+    Locate<char>(diagnostics, input);
+}
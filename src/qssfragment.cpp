@@ -1,10 +1,16 @@
 #include "../include/qssfragment.h"
+#include "../include/qsswriter.h"
 
 qss::Fragment::Fragment(const QString & input)
 {
     parse(input);
 }
 
+qss::Fragment::Fragment(const QString &input, const allocator_type &allocator) : Fragment{ allocator }
+{
+    parse(input);
+}
+
 qss::Fragment& qss::Fragment::operator=(const Fragment &fragment)
 {
     m_selector = fragment.m_selector;
@@ -12,15 +18,34 @@ qss::Fragment& qss::Fragment::operator=(const Fragment &fragment)
     return *this;
 }
 
+qss::Fragment& qss::Fragment::operator=(Fragment &&fragment)
+{
+    if (this == &fragment)
+    {
+        return *this;
+    }
+
+    m_selector = std::move(fragment.m_selector);
+    m_block = std::move(fragment.m_block);
+    return *this;
+}
+
 qss::Fragment& qss::Fragment::select(const Selector& selector)
 {
     m_selector = selector;
     return *this;
 }
 
+qss::Fragment& qss::Fragment::select(Selector&& selector)
+{
+    m_selector = std::move(selector);
+    return *this;
+}
+
 qss::Fragment& qss::Fragment::select(const QString &selector)
 {
-    m_selector.parse(selector);
+    // Selector::parse appends, so the old selector would be kept as a prefix
+    m_selector = Selector{ selector, m_selector.get_allocator() };
     return *this;
 }
 
@@ -30,6 +55,12 @@ qss::Fragment& qss::Fragment::addBlock(const PropertyBlock& block)
     return *this;
 }
 
+qss::Fragment& qss::Fragment::addBlock(PropertyBlock&& block)
+{
+    m_block += std::move(block);
+    return *this;
+}
+
 qss::Fragment& qss::Fragment::addBlock(const QString &block)
 {
     m_block += block;
@@ -74,37 +105,65 @@ qss::Fragment& qss::Fragment::remove(const std::vector<QString> &names)
 
 void qss::Fragment::parse(const QString &input)
 {
-    auto str = input.trimmed();
+    Lexer lexer;
+    lexer.feed(input);
+    lexer.finish();
 
-    if (str.size() > 0)
+    if (lexer.tokens().size() > 0)
+    {
+        parse(lexer, lexer.tokens().front());
+    }
+    else
     {
-        auto start = str.indexOf(Delimiters.at(QSS_BLOCK_START_DELIMITER));
-        auto end = str.indexOf(Delimiters.at(QSS_BLOCK_END_DELIMITER));
+        auto str = lexer.buffer().trimmed();
 
-        if ((end - start) > 0)
-        {
-            QString header = str, body = str;
-            m_selector.parse(header.remove(start, header.size()).trimmed());
-            body = body.left(end);
-            body.remove(0, start + 1);
-            m_block.parse(body.trimmed());
-        }
-        else
+        if (str.size() > 0)
         {
             throw Exception{ Exception::BLOCK_BRACKETS_INVALID, str };
         }
     }
 }
 
+void qss::Fragment::parse(const Lexer &lexer, const Lexer::Token &token)
+{
+    m_selector.parse(lexer.string(token.selector));
+    m_block.parse(lexer, token);
+}
+
+void qss::Fragment::parse(const Utf8Lexer &lexer, const Lexer::Token &token)
+{
+    m_selector.parse(lexer.string(token.selector));
+    m_block.parse(lexer, token);
+}
+
+bool qss::Fragment::parse(const Lexer &lexer, const Lexer::Token &token, int &error)
+{
+    if (!m_selector.parse(lexer.string(token.selector), error))
+    {
+        return false;
+    }
+
+    m_block.parse(lexer, token);
+    return true;
+}
+
+bool qss::Fragment::parse(const Utf8Lexer &lexer, const Lexer::Token &token, int &error)
+{
+    if (!m_selector.parse(lexer.string(token.selector), error))
+    {
+        return false;
+    }
+
+    m_block.parse(lexer, token);
+    return true;
+}
+
 QString qss::Fragment::toString() const
 {
-    QString result = m_selector.toString();
-    result += " " + Delimiters.at(QSS_BLOCK_START_DELIMITER) + "\n";
-    result += m_block.toString() + Delimiters.at(QSS_BLOCK_END_DELIMITER) + "\n";
-    return result;
+    return Writer::toString(*this);
 }
 
 bool qss::operator==(const Fragment &lhs, const Fragment &rhs)
 {
-    return lhs.toString() == rhs.toString();
+    return lhs.m_selector == rhs.m_selector && lhs.m_block == rhs.m_block;
 }
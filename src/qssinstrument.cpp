@@ -0,0 +1,243 @@
+#include "../include/qssinstrument.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+namespace
+{
+    typedef qss::Instrument Instrument;
+
+    struct Event
+    {
+        Instrument::Phase phase;
+        quint64           start;
+        quint64           duration;
+        quint64           allocations;
+        quint64           thread;
+    };
+
+    struct State
+    {
+        std::atomic<bool>                                          enabled{ false };
+        std::atomic<bool>                                          tracing{ false };
+        std::atomic<quint64 (*)()>                                 allocations{ nullptr };
+        std::array<std::atomic<quint64>, Instrument::PHASE_COUNT>   calls{};
+        std::array<std::atomic<quint64>, Instrument::PHASE_COUNT>   nanoseconds{};
+        std::array<std::atomic<quint64>, Instrument::PHASE_COUNT>   phaseAllocations{};
+        std::array<std::atomic<quint64>, Instrument::COUNTER_COUNT> counters{};
+        std::atomic<quint64>                                       threads{ 0 };
+
+        std::mutex         mutex;   // guards the trace
+        std::vector<Event> events;
+        std::size_t        maxEvents = 0;
+        quint64            traceStart = 0;
+    };
+
+    State& Instance()
+    {
+        static State state;
+        return state;
+    }
+
+    // Scopes of each phase open on this thread
+    thread_local std::array<int, Instrument::PHASE_COUNT> Depth{};
+
+    quint64 Now()
+    {
+        return static_cast<quint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Small sequential ids read better in a trace viewer than native handles
+    quint64 ThreadId()
+    {
+        thread_local const quint64 id = ++Instance().threads;
+        return id;
+    }
+
+    QByteArray Microseconds(qint64 nanoseconds)
+    {
+        return QByteArray::number(static_cast<double>(nanoseconds) / 1000.0, 'f', 3);
+    }
+}
+
+qss::Instrument::Scope::Scope(Phase phase) : m_phase{ phase }
+{
+    auto& state = Instance();
+
+    if (state.enabled.load(std::memory_order_relaxed))
+    {
+        m_entered = true;
+        m_active = Depth[phase]++ == 0;
+
+        if (m_active)
+        {
+            auto counter = state.allocations.load(std::memory_order_relaxed);
+            m_allocations = counter != nullptr ? counter() : 0;
+            m_start = Now();
+        }
+    }
+}
+
+qss::Instrument::Scope::~Scope()
+{
+    if (!m_entered)
+    {
+        return;
+    }
+
+    --Depth[m_phase];
+
+    if (!m_active)
+    {
+        return;
+    }
+
+    auto& state = Instance();
+    const auto duration = Now() - m_start;
+    auto counter = state.allocations.load(std::memory_order_relaxed);
+    const auto allocations = counter != nullptr ? counter() - m_allocations : 0;
+
+    state.calls[m_phase].fetch_add(1, std::memory_order_relaxed);
+    state.nanoseconds[m_phase].fetch_add(duration, std::memory_order_relaxed);
+    state.phaseAllocations[m_phase].fetch_add(allocations, std::memory_order_relaxed);
+
+    if (state.tracing.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock{ state.mutex };
+
+        if (state.events.size() < state.maxEvents)
+        {
+            state.events.push_back(Event{ m_phase, m_start, duration, allocations, ThreadId() });
+        }
+    }
+}
+
+void qss::Instrument::enable(bool enable)
+{
+    Instance().enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool qss::Instrument::isEnabled() noexcept
+{
+    return Instance().enabled.load(std::memory_order_relaxed);
+}
+
+void qss::Instrument::reset()
+{
+    auto& state = Instance();
+
+    for (int i = 0; i < PHASE_COUNT; ++i)
+    {
+        state.calls[i] = 0;
+        state.nanoseconds[i] = 0;
+        state.phaseAllocations[i] = 0;
+    }
+
+    for (auto& counter : state.counters)
+    {
+        counter = 0;
+    }
+
+    std::lock_guard<std::mutex> lock{ state.mutex };
+    state.events.clear();
+    state.traceStart = Now();
+}
+
+void qss::Instrument::startTrace(std::size_t maxEvents)
+{
+    auto& state = Instance();
+    std::lock_guard<std::mutex> lock{ state.mutex };
+    state.events.clear();
+    state.maxEvents = maxEvents;
+    state.traceStart = Now();
+    state.tracing = true;
+}
+
+void qss::Instrument::stopTrace()
+{
+    Instance().tracing = false;
+}
+
+void qss::Instrument::setAllocationCounter(quint64 (*counter)())
+{
+    Instance().allocations = counter;
+}
+
+void qss::Instrument::count(Counter counter, quint64 amount)
+{
+    auto& state = Instance();
+
+    if (state.enabled.load(std::memory_order_relaxed))
+    {
+        state.counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+qss::Instrument::PhaseStats qss::Instrument::phase(Phase phase)
+{
+    const auto& state = Instance();
+    PhaseStats stats;
+    stats.calls = state.calls[phase].load(std::memory_order_relaxed);
+    stats.nanoseconds = state.nanoseconds[phase].load(std::memory_order_relaxed);
+    stats.allocations = state.phaseAllocations[phase].load(std::memory_order_relaxed);
+    return stats;
+}
+
+quint64 qss::Instrument::counter(Counter counter)
+{
+    return Instance().counters[counter].load(std::memory_order_relaxed);
+}
+
+const char* qss::Instrument::name(Phase phase) noexcept
+{
+    static const char* const Names[PHASE_COUNT] = { "lex", "selector_parse", "block_parse", "serialize" };
+    return Names[phase];
+}
+
+const char* qss::Instrument::name(Counter counter) noexcept
+{
+    static const char* const Names[COUNTER_COUNT] = { "fragments", "properties", "bytes" };
+    return Names[counter];
+}
+
+QByteArray qss::Instrument::traceEvents()
+{
+    auto& state = Instance();
+    std::lock_guard<std::mutex> lock{ state.mutex };
+    QByteArray json{ "{\"traceEvents\":[" };
+    quint64 end = state.traceStart;
+
+    for (const auto& event : state.events)
+    {
+        json += "\n{\"name\":\"";
+        json += name(event.phase);
+        json += "\",\"cat\":\"qss\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+        json += QByteArray::number(event.thread);
+        json += ",\"ts\":";
+        json += Microseconds(static_cast<qint64>(event.start - state.traceStart));
+        json += ",\"dur\":";
+        json += Microseconds(static_cast<qint64>(event.duration));
+        json += ",\"args\":{\"allocations\":";
+        json += QByteArray::number(event.allocations);
+        json += "}},";
+        end = std::max(end, event.start + event.duration);
+    }
+
+    json += "\n{\"name\":\"counters\",\"cat\":\"qss\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":";
+    json += Microseconds(static_cast<qint64>(end - state.traceStart));
+    json += ",\"args\":{";
+
+    for (int i = 0; i < COUNTER_COUNT; ++i)
+    {
+        json += i == 0 ? "\"" : ",\"";
+        json += name(static_cast<Counter>(i));
+        json += "\":";
+        json += QByteArray::number(counter(static_cast<Counter>(i)));
+    }
+
+    json += "}}\n],\"displayTimeUnit\":\"ns\"}\n";
+    return json;
+}
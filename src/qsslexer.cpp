@@ -0,0 +1,371 @@
+#include "../include/qsslexer.h"
+#include "../include/qssexception.h"
+#include "../include/qssinstrument.h"
+
+template <typename Char>
+void qss::BasicLexer<Char>::reset(Context context)
+{
+    m_context = context;
+    m_state = NORMAL;
+    m_inBlock = context == BLOCK;
+    m_external = false;
+    m_read = m_write = 0;
+    m_fragmentStart = m_blockStart = m_declarationStart = 0;
+    m_colon = -1;
+    m_firstDeclaration = 0;
+    m_source = m_fragmentSource = m_declarationSource = 0;
+    m_depth = 0;
+    m_invalid = false;
+    m_data = nullptr;
+    m_buffer.clear();
+    m_tokens.clear();
+    m_declarations.clear();
+}
+
+template <typename Char>
+void qss::BasicLexer<Char>::feed(const Buffer& input)
+{
+    if (m_buffer.isEmpty())
+    {
+        // Share the input; the first write in lex() detaches it exactly once
+        m_buffer = input;
+    }
+    else
+    {
+        m_buffer.append(input);
+    }
+
+    m_data = m_buffer.data();
+    lex(m_buffer.size());
+}
+
+template <typename Char>
+void qss::BasicLexer<Char>::feed(View input)
+{
+    m_buffer.append(input);
+    m_data = m_buffer.data();
+    lex(m_buffer.size());
+}
+
+template <typename Char>
+void qss::BasicLexer<Char>::lex(Char* data, qsizetype size)
+{
+    // The caller keeps ownership of data, which must outlive the spans
+    m_external = true;
+    m_data = data;
+    lex(size);
+}
+
+template <typename Char>
+void qss::BasicLexer<Char>::finish()
+{
+    if (m_state == SLASH)
+    {
+        if (m_external)
+        {
+            // The slash itself was read at or after the write position
+            m_data[m_write++] = '/';
+        }
+        else
+        {
+            m_buffer.append(Char('/'));
+            m_data = m_buffer.data();
+            m_read = ++m_write;
+        }
+    }
+
+    m_state = NORMAL;
+
+    // A trailing fragment without its closing bracket is dropped, but the
+    // body of a standalone block ends with the input
+    if (m_context == BLOCK && m_inBlock)
+    {
+        closeBlock();
+        m_inBlock = true;
+    }
+    else if (m_diagnostics != nullptr && (m_inBlock || trimmed(m_fragmentStart, m_write).length > 0))
+    {
+        m_diagnostics->push_back(Diagnostic{ Exception::BLOCK_BRACKETS_INVALID, m_fragmentSource });
+    }
+}
+
+template <typename Char>
+void qss::BasicLexer<Char>::discardTokens()
+{
+    // Everything before the fragment being lexed has been reported, so only
+    // the partial fragment and its declarations are kept
+    const auto offset = m_fragmentStart;
+    const auto first = m_firstDeclaration;
+
+    if (m_external)
+    {
+        m_data += offset;
+    }
+    else
+    {
+        m_buffer.remove(0, offset);
+        m_data = m_buffer.data();
+    }
+
+    m_tokens.clear();
+    m_declarations.erase(m_declarations.begin(), m_declarations.begin() + first);
+
+    for (auto& declaration : m_declarations)
+    {
+        declaration.key.begin -= offset;
+        declaration.value.begin -= offset;
+    }
+
+    m_read -= offset;
+    m_write -= offset;
+    m_fragmentStart = 0;
+    m_blockStart -= offset;
+    m_declarationStart -= offset;
+    m_colon = m_colon < 0 ? m_colon : m_colon - offset;
+    m_firstDeclaration = 0;
+}
+
+template <typename Char>
+inline void qss::BasicLexer<Char>::put(qsizetype index, Char c)
+{
+    // Text that does not move is not rewritten, so the pages of a private
+    // file mapping are only copied once a comment has shifted the text
+    if (m_write != index || !(m_data[index] == c))
+    {
+        m_data[m_write] = c;
+    }
+
+    ++m_write;
+}
+
+template <typename Char>
+void qss::BasicLexer<Char>::lex(qsizetype size)
+{
+    QSS_SCOPE(LEX);
+    QSS_COUNT(BYTES, (size - m_read) * static_cast<qsizetype>(sizeof(Char)));
+#ifdef QSS_INSTRUMENT
+    const auto tokens = m_tokens.size();
+    const auto declarations = m_declarations.size();
+#endif
+
+    // Comments only ever shrink the text, so the cleaned output is written
+    // over the input it was read from
+    Char* data = m_data;
+    const auto source = m_source - m_read;
+
+    for (auto i = m_read; i < size; ++i)
+    {
+        const auto c = Traits::unit(data[i]);
+
+        switch (m_state)
+        {
+        case COMMENT:
+            if (c == '*') m_state = COMMENT_STAR;
+            continue;
+
+        case COMMENT_STAR:
+            if (c == '/') m_state = NORMAL;
+            else if (c != '*') m_state = COMMENT;
+            continue;
+
+        case STRING:
+            if (c == '\\') m_state = STRING_ESCAPE;
+            else if (c == m_quote) m_state = NORMAL;
+            put(i, data[i]);
+            continue;
+
+        case STRING_ESCAPE:
+            m_state = STRING;
+            put(i, data[i]);
+            continue;
+
+        case ESCAPE:
+            m_state = NORMAL;
+            put(i, data[i]);
+            continue;
+
+        case SLASH:
+            if (c == '*')
+            {
+                m_state = COMMENT;
+                continue;
+            }
+
+            m_state = NORMAL;
+            put(i - 1, '/');
+            break;
+
+        case NORMAL:
+            break;
+        }
+
+        switch (c)
+        {
+        case '/':
+            m_state = SLASH;
+            continue;
+
+        case '"':
+        case '\'':
+            m_state = STRING;
+            m_quote = c;
+            break;
+
+        case '\\':
+            m_state = ESCAPE;
+            break;
+
+        case '{':
+            openBlock(source + i);
+            break;
+
+        case '}':
+            if (m_depth > 0)
+            {
+                --m_depth;
+                break;
+            }
+            else if (!m_inBlock || m_context == BLOCK)
+            {
+                if (m_diagnostics == nullptr)
+                {
+                    throw Exception{ Exception::BLOCK_BRACKETS_INVALID, string(Span{ m_fragmentStart, m_write - m_fragmentStart }) + QChar('}') };
+                }
+
+                m_diagnostics->push_back(Diagnostic{ Exception::BLOCK_BRACKETS_INVALID, source + i });
+
+                if (m_context == DOCUMENT)
+                {
+                    // The next fragment, and where its own problems are reported, starts past the brace
+                    m_fragmentStart = m_write;
+                    m_fragmentSource = source + i + 1;
+                }
+                continue;
+            }
+            closeBlock();
+            break;
+
+        case ';':
+            if (m_inBlock && m_depth == 0)
+            {
+                closeDeclaration();
+                m_declarationStart = m_write + 1;
+                m_declarationSource = source + i + 1;
+            }
+            break;
+
+        case ':':
+            if (m_inBlock && m_depth == 0 && m_colon < 0)
+            {
+                m_colon = m_write;
+            }
+            break;
+        }
+
+        put(i, data[i]);
+
+        if (c == '}' && !m_inBlock)
+        {
+            m_fragmentStart = m_write;
+            m_tokens.back().source = Span{ m_fragmentSource, source + i + 1 - m_fragmentSource };
+            m_fragmentSource = source + i + 1;
+        }
+    }
+
+    m_source = source + size;
+    QSS_COUNT(FRAGMENTS, m_tokens.size() - tokens);
+    QSS_COUNT(PROPERTIES, m_declarations.size() - declarations);
+
+    if (m_external)
+    {
+        m_read = size;
+    }
+    else
+    {
+        m_buffer.truncate(m_write);
+        m_data = m_buffer.data();
+        m_read = m_write;
+    }
+}
+
+template <typename Char>
+void qss::BasicLexer<Char>::openBlock(qsizetype position)
+{
+    if (m_inBlock)
+    {
+        if (m_diagnostics == nullptr)
+        {
+            throw Exception{ Exception::BLOCK_BRACKETS_INVALID, string(Span{ m_fragmentStart, m_write - m_fragmentStart }) + QChar('{') };
+        }
+
+        if (m_depth++ == 0)
+        {
+            m_diagnostics->push_back(Diagnostic{ Exception::BLOCK_BRACKETS_INVALID, position });
+            m_invalid = true;
+        }
+
+        return;
+    }
+
+    m_inBlock = true;
+    m_declarationSource = position + 1;
+    m_blockStart = m_declarationStart = m_write + 1;
+    m_colon = -1;
+    m_firstDeclaration = static_cast<qsizetype>(m_declarations.size());
+}
+
+template <typename Char>
+void qss::BasicLexer<Char>::closeBlock()
+{
+    closeDeclaration();
+
+    Token token;
+    token.selector = m_context == BLOCK ? Span{} : trimmed(m_fragmentStart, m_blockStart - 1);
+    token.block = trimmed(m_blockStart, m_write);
+    token.firstDeclaration = m_firstDeclaration;
+    token.declarationCount = static_cast<qsizetype>(m_declarations.size()) - m_firstDeclaration;
+    m_tokens.push_back(token);
+
+    m_inBlock = false;
+    m_firstDeclaration = static_cast<qsizetype>(m_declarations.size());
+}
+
+template <typename Char>
+void qss::BasicLexer<Char>::closeDeclaration()
+{
+    auto statement = trimmed(m_declarationStart, m_write);
+
+    if (statement.length > 0 && !m_invalid)
+    {
+        if (m_colon >= 0)
+        {
+            m_declarations.push_back({ trimmed(statement.begin, m_colon), trimmed(m_colon + 1, m_write) });
+        }
+        else if (m_diagnostics == nullptr)
+        {
+            throw Exception{ Exception::BLOCK_PARAM_INVALID, string(statement) };
+        }
+        else
+        {
+            m_diagnostics->push_back(Diagnostic{ Exception::BLOCK_PARAM_INVALID, m_declarationSource });
+        }
+    }
+
+    m_colon = -1;
+    m_invalid = false;
+}
+
+template <typename Char>
+typename qss::BasicLexer<Char>::Span qss::BasicLexer<Char>::trimmed(qsizetype begin, qsizetype end) const
+{
+    while (begin < end && Traits::isSpace(m_data[begin])) ++begin;
+    while (end > begin && Traits::isSpace(m_data[end - 1])) --end;
+
+    return Span{ begin, end - begin };
+}
+
+namespace qss
+{
+    template class QSS_API BasicLexer<QChar>;
+    template class QSS_API BasicLexer<char>;
+}
@@ -0,0 +1,362 @@
+#include "../include/qssmatcher.h"
+
+namespace
+{
+    bool Contains(const qss::AtomList& list, qss::Atom atom)
+    {
+        return std::find(list.cbegin(), list.cend(), atom) != list.cend();
+    }
+
+    const qss::Atom& Universal()
+    {
+        static const qss::Atom universal{ "*" };
+        return universal;
+    }
+
+    // The empty atom, which no named selector matches, for a name never interned
+    qss::Atom Lookup(const QString& name)
+    {
+        return qss::Atom::find(name).value_or(qss::Atom{});
+    }
+
+    void Lookup(const QStringList& names, qss::AtomList& atoms)
+    {
+        for (const auto& name : names)
+        {
+            if (auto atom = qss::Atom::find(name))
+            {
+                atoms.push_back(*atom);
+            }
+        }
+    }
+}
+
+qss::Matcher::Names::Names(const Element& element)
+    : type{ Lookup(element.type) }, id{ Lookup(element.id) }, subControl{ Lookup(element.subControl) },
+      unknownSubControl{ !element.subControl.isEmpty() && subControl.isEmpty() }
+{
+    Lookup(element.inherits, inherits);
+    Lookup(element.classes, classes);
+
+    for (const auto& pair : element.params)
+    {
+        if (auto key = Atom::find(pair.first))
+        {
+            params.emplace(*key, pair.second);
+        }
+    }
+}
+
+qss::Matcher::Matcher(const Document& document)
+    : m_document{ &document }
+{
+    addRules();
+}
+
+qss::Matcher::Matcher(Snapshot snapshot)
+    : m_snapshot{ std::move(snapshot) }
+{
+    addRules();
+}
+
+void qss::Matcher::addRules()
+{
+    for (std::size_t i = 0; i < totalFragments(); ++i)
+    {
+        const auto& selector = fragment(i).selector();
+        const auto count = static_cast<int>(selector.fragmentCount());
+        auto first = 0;
+
+        // "a, b" is stored as one selector whose alternatives start at the
+        // ADJACENT elements; each alternative is a separate rule
+        for (auto j = 1; j < count; ++j)
+        {
+            if (selector[j].position() == SelectorElement::ADJACENT)
+            {
+                addRule(Rule{ i, first, j - 1, selector.specificity(first, j - 1) });
+                first = j;
+            }
+        }
+
+        if (count > 0)
+        {
+            addRule(Rule{ i, first, count - 1, selector.specificity(first, count - 1) });
+        }
+    }
+}
+
+std::vector<std::size_t> qss::Matcher::match(const Element& element) const
+{
+    std::vector<std::size_t> fragments;
+
+    for (const auto& match : matchRules(element))
+    {
+        fragments.push_back(match.first);
+    }
+
+    return fragments;
+}
+
+qss::PropertyBlock qss::Matcher::computeStyle(const Element& element, std::vector<std::size_t>* fragments) const
+{
+    auto matches = matchRules(element);
+
+    if (fragments != nullptr)
+    {
+        fragments->clear();
+
+        for (const auto& match : matches)
+        {
+            fragments->push_back(match.first);
+        }
+    }
+
+    // Matches arrive in source order, so a stable sort on specificity alone
+    // leaves later fragments after earlier ones of equal weight
+    std::stable_sort(matches.begin(), matches.end(), [](const RuleMatch& lhs, const RuleMatch& rhs) {
+        return lhs.second < rhs.second;
+    });
+
+    PropertyBlock style;
+
+    for (const auto& match : matches)
+    {
+        const auto& block = fragment(match.first).block();
+
+        for (auto itr = block.cbegin(); itr != block.cend(); ++itr)
+        {
+            if (itr->second.second)
+            {
+                style += *itr;
+            }
+        }
+    }
+
+    return style;
+}
+
+std::vector<qss::Matcher::RuleMatch> qss::Matcher::matchRules(const Element& element) const
+{
+    NameCache cache;
+    const auto& names = lookup(element, cache);
+
+    if (names.unknownSubControl)
+    {
+        return {};
+    }
+
+    std::vector<std::size_t> candidates{ m_universal };
+
+    if (!names.id.isEmpty())
+    {
+        collect(m_ids, names.id, candidates);
+    }
+
+    for (const auto& cl : names.classes)
+    {
+        collect(m_classes, cl, candidates);
+    }
+
+    // Qt matches .QPushButton against the exact class name
+    collect(m_classes, names.type, candidates);
+    collect(m_types, names.type, candidates);
+
+    for (const auto& type : names.inherits)
+    {
+        collect(m_types, type, candidates);
+    }
+
+    for (const auto& pair : names.params)
+    {
+        collect(m_params, pair.first, candidates);
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // Rules are numbered in source order, so the fragments come out sorted.
+    // A fragment matched by several alternatives weighs as the most specific.
+    std::vector<RuleMatch> fragments;
+
+    for (auto index : candidates)
+    {
+        const auto& rule = m_rules[index];
+
+        if (!isEnabled(rule.fragment) || !matches(rule, rule.last, element, cache))
+        {
+            continue;
+        }
+
+        if (!fragments.empty() && fragments.back().first == rule.fragment)
+        {
+            fragments.back().second = std::max(fragments.back().second, rule.specificity);
+        }
+        else
+        {
+            fragments.emplace_back(rule.fragment, rule.specificity);
+        }
+    }
+
+    return fragments;
+}
+
+bool qss::Matcher::matches(const SelectorElement& selector, const Element& element)
+{
+    return matches(selector, element, Names{ element });
+}
+
+bool qss::Matcher::matches(const SelectorElement& selector, const Element& element, const Names& names)
+{
+    const auto name = selector.name();
+
+    if (!name.isEmpty() && name != Universal() && name != names.type && !Contains(names.inherits, name))
+    {
+        return false;
+    }
+
+    if (!selector.id().isEmpty() && selector.id() != names.id)
+    {
+        return false;
+    }
+
+    for (const auto& cl : selector.classes())
+    {
+        if (cl != names.type && !Contains(names.classes, cl))
+        {
+            return false;
+        }
+    }
+
+    for (const auto& pair : selector.params())
+    {
+        auto itr = names.params.find(pair.first);
+
+        if (itr == names.params.cend() || itr->second != pair.second)
+        {
+            return false;
+        }
+    }
+
+    if (names.unknownSubControl || selector.subControl() != names.subControl)
+    {
+        return false;
+    }
+
+    for (const auto& state : selector.psuedoClass().split(Delimiters.at(QSS_PSEUDO_CLASS_DELIMITER), Qt::SkipEmptyParts))
+    {
+        const auto negated = state.startsWith('!');
+
+        if (element.states.contains(negated ? state.mid(1) : state) == negated)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void qss::Matcher::addRule(const Rule& rule)
+{
+    const auto index = m_rules.size();
+    const auto& selector = fragment(rule.fragment).selector()[rule.last];
+
+    m_rules.push_back(rule);
+
+    if (!selector.id().isEmpty())
+    {
+        m_ids[selector.id()].push_back(index);
+    }
+    else if (selector.classCount() > 0)
+    {
+        m_classes[selector.classes().front()].push_back(index);
+    }
+    else if (!selector.name().isEmpty() && selector.name() != Universal())
+    {
+        m_types[selector.name()].push_back(index);
+    }
+    else if (selector.paramCount() > 0)
+    {
+        m_params[selector.params().begin()->first].push_back(index);
+    }
+    else
+    {
+        m_universal.push_back(index);
+    }
+}
+
+bool qss::Matcher::matches(const Rule& rule, int index, const Element& element, NameCache& names) const
+{
+    const auto& selector = fragment(rule.fragment).selector();
+
+    if (!matches(selector[index], element, lookup(element, names)))
+    {
+        return false;
+    }
+
+    if (index == rule.first)
+    {
+        return true;
+    }
+
+    // The position of an element is the combinator joining it to the one on its left
+    switch (selector[index].position())
+    {
+    case SelectorElement::CHILD:
+        return element.parent != nullptr && matches(rule, index - 1, *element.parent, names);
+
+    case SelectorElement::GENERAL_SIBLING:
+        // Written "+": the immediately preceding sibling
+        return element.previousSibling != nullptr && matches(rule, index - 1, *element.previousSibling, names);
+
+    case SelectorElement::SIBLING:
+        // Written "~": any preceding sibling
+        for (auto sibling = element.previousSibling; sibling != nullptr; sibling = sibling->previousSibling)
+        {
+            if (matches(rule, index - 1, *sibling, names))
+            {
+                return true;
+            }
+        }
+        return false;
+
+    default:
+        for (auto ancestor = element.parent; ancestor != nullptr; ancestor = ancestor->parent)
+        {
+            if (matches(rule, index - 1, *ancestor, names))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+const qss::Matcher::Names& qss::Matcher::lookup(const Element& element, NameCache& names)
+{
+    return names.try_emplace(&element, element).first->second;
+}
+
+void qss::Matcher::collect(const Buckets& buckets, Atom key, std::vector<std::size_t>& candidates)
+{
+    auto itr = buckets.find(key);
+
+    if (itr != buckets.cend())
+    {
+        candidates.insert(candidates.end(), itr->second.cbegin(), itr->second.cend());
+    }
+}
+
+std::size_t qss::Matcher::totalFragments() const
+{
+    return m_document != nullptr ? m_document->totalFragments() : m_snapshot.totalFragments();
+}
+
+const qss::Fragment& qss::Matcher::fragment(std::size_t index) const
+{
+    return m_document != nullptr ? (*m_document)[static_cast<int>(index)] : m_snapshot[index];
+}
+
+bool qss::Matcher::isEnabled(std::size_t index) const
+{
+    return m_document != nullptr ? m_document->isEnabled(static_cast<int>(index)) : m_snapshot.isEnabled(index);
+}
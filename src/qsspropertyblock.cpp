@@ -1,31 +1,80 @@
 #include "../include/qsspropertyblock.h"
+#include "../include/qsswriter.h"
+#include "../include/qssinstrument.h"
 
 qss::PropertyBlock::PropertyBlock(const QString & str)
 {
     parse(str);
 }
 
+qss::PropertyBlock::PropertyBlock(const PropertyBlock &block, const allocator_type &allocator)
+    : m_params{ block.m_params, allocator }, m_keys{ block.m_keys, allocator },
+      m_index{ block.m_index ? new Index{ *block.m_index } : nullptr }, m_hash{ block.m_hash }
+{
+}
+
+qss::PropertyBlock::PropertyBlock(PropertyBlock &&block)
+    : m_params{ std::move(block.m_params) }, m_keys{ std::move(block.m_keys) },
+      m_index{ std::move(block.m_index) }, m_hash{ block.m_hash }
+{
+    block.m_generation = nextGeneration();
+    block.m_hash = 0;
+}
+
+// The index holds positions, not pointers, so it stays valid even when the
+// params are moved into another resource one by one
+qss::PropertyBlock::PropertyBlock(PropertyBlock &&block, const allocator_type &allocator)
+    : m_params{ std::move(block.m_params), allocator }, m_keys{ std::move(block.m_keys), allocator },
+      m_index{ std::move(block.m_index) }, m_hash{ block.m_hash }
+{
+    block.m_params.clear();
+    block.m_keys.clear();
+    block.m_generation = nextGeneration();
+    block.m_hash = 0;
+}
+
 qss::PropertyBlock& qss::PropertyBlock::operator=(const PropertyBlock &block)
 {
+    m_generation = nextGeneration();
     m_params = block.m_params;
+    m_keys = block.m_keys;
+    m_index.reset(block.m_index ? new Index{ *block.m_index } : nullptr);
+    m_hash = block.m_hash;
+    return *this;
+}
+
+qss::PropertyBlock& qss::PropertyBlock::operator=(PropertyBlock &&block)
+{
+    if (this == &block)
+    {
+        return *this;
+    }
+
+    m_generation = nextGeneration();
+    m_params = std::move(block.m_params);
+    m_keys = std::move(block.m_keys);
+    m_index = std::move(block.m_index);
+    m_hash = block.m_hash;
+    block.m_params.clear();
+    block.m_keys.clear();
+    block.m_generation = nextGeneration();
+    block.m_hash = 0;
     return *this;
 }
 
 qss::PropertyBlock& qss::PropertyBlock::addParam(const QString &key, const QString &value)
 {
-    auto tkey = key.trimmed();
-    m_params[tkey].first = value.trimmed();
-    m_params[tkey].second = true;
+    m_generation = nextGeneration();
+    set(Atom{ key.trimmed() }, { value.trimmed(), true });
     return *this;
 }
 
 qss::PropertyBlock& qss::PropertyBlock::addParam(const QStringPairs &params)
 {
+    m_generation = nextGeneration();
     for (const auto& param : params)
     {
-        auto tkey = param.first.trimmed();
-        m_params[tkey].first = param.second.trimmed();
-        m_params[tkey].second = true;
+        set(Atom{ param.first.trimmed() }, { param.second.trimmed(), true });
     }
 
     return *this;
@@ -33,12 +82,12 @@ qss::PropertyBlock& qss::PropertyBlock::addParam(const QStringPairs &params)
 
 qss::PropertyBlock& qss::PropertyBlock::enableParam(const QString &key, bool enable)
 {
-    auto tkey = key.trimmed();
-    auto itr = m_params.find(tkey);
+    m_generation = nextGeneration();
+    auto index = indexOf(key.trimmed());
 
-    if (itr != m_params.cend())
+    if (index != npos)
     {
-        m_params[tkey].second = enable;
+        this->enable(index, enable);
     }
 
     return *this;
@@ -46,12 +95,12 @@ qss::PropertyBlock& qss::PropertyBlock::enableParam(const QString &key, bool ena
 
 qss::PropertyBlock& qss::PropertyBlock::toggleParam(const QString &key)
 {
-    auto tkey = key.trimmed();
-    auto itr = m_params.find(tkey);
+    m_generation = nextGeneration();
+    auto index = indexOf(key.trimmed());
 
-    if (itr != m_params.cend())
+    if (index != npos)
     {
-        m_params[tkey].second = !itr->second.second;
+        enable(index, !m_params[index].second.second);
     }
 
     return *this;
@@ -59,9 +108,12 @@ qss::PropertyBlock& qss::PropertyBlock::toggleParam(const QString &key)
 
 qss::PropertyBlock& qss::PropertyBlock::remove(const QString &key)
 {
-    if (m_params.count(key))
+    m_generation = nextGeneration();
+    auto index = indexOf(key);
+
+    if (index != npos)
     {
-        m_params.erase(key);
+        erase(index);
     }
 
     return *this;
@@ -79,11 +131,34 @@ qss::PropertyBlock& qss::PropertyBlock::remove(const std::vector<QString> &keys)
 
 qss::PropertyBlock& qss::PropertyBlock::operator+=(const PropertyBlock & block)
 {
+    m_generation = nextGeneration();
     for (const auto& pair : block.m_params)
     {
-        m_params[pair.first] = pair.second;
+        set(pair.first, pair.second);
+    }
+
+    return *this;
+}
+
+qss::PropertyBlock& qss::PropertyBlock::operator+=(PropertyBlock && block)
+{
+    // Nothing to merge into, so the whole block is taken over
+    if (m_params.empty() && get_allocator() == block.get_allocator())
+    {
+        return *this = std::move(block);
+    }
+
+    m_generation = nextGeneration();
+    for (auto& pair : block.m_params)
+    {
+        set(pair.first, std::move(pair.second));
     }
 
+    block.m_params.clear();
+    block.m_keys.clear();
+    block.m_index.reset();
+    block.m_generation = nextGeneration();
+    block.m_hash = 0;
     return *this;
 }
 
@@ -92,60 +167,258 @@ qss::PropertyBlock& qss::PropertyBlock::operator+=(const QString & block)
     return this->operator+=(PropertyBlock{ block });
 }
 
+qss::PropertyBlock& qss::PropertyBlock::operator+=(const Param & param)
+{
+    // Copies the value whole, so an already parsed reading is shared
+    m_generation = nextGeneration();
+    set(param.first, param.second);
+    return *this;
+}
+
 void qss::PropertyBlock::parse(const QString &input)
 {
-    auto str = input.trimmed();
+    Lexer lexer{ Lexer::BLOCK };
+    lexer.feed(input);
+    lexer.finish();
+    parse(lexer, lexer.tokens().front());
+}
 
-    if (str.size() > 0)
+namespace
+{
+    qss::Property KeyProperty(QStringView key)
     {
-        auto parts = str.split(Delimiters.at(QSS_STATEMENT_END_DELIMITER), Qt::SkipEmptyParts);
+        return qss::propertyFromName(key);
+    }
 
-        for (auto const& part : parts)
-        {
-            auto line = part.split(Delimiters.at(QSS_PSEUDO_CLASS_DELIMITER), Qt::SkipEmptyParts);
-
-            // Allow more than 2 types in split, because the property value may
-            // contain further delimiters inside quotes. This is not a solution,
-            // but only a workaround: a full parsing of quoted content must be done instead.
-            if (line.size() >= 2)
-            {
-                auto key = line[0].trimmed();
-                auto value = line[1].trimmed();
-                m_params[key].first = value;
-                m_params[key].second = true;
-            }
-            else
-            {
-                throw Exception{ Exception::BLOCK_PARAM_INVALID, part };
-            }
-        }
+    qss::Property KeyProperty(QByteArrayView key)
+    {
+        return qss::propertyFromName(std::string_view{ key.data(), static_cast<std::size_t>(key.size()) });
+    }
+
+    template <typename Char>
+    qss::Atom KeyAtom(const qss::BasicLexer<Char>& lexer, const qss::Lexer::Span& key)
+    {
+        // Known names are resolved straight from the buffer, without building a string
+        const auto property = KeyProperty(lexer.text(key));
+        return property != qss::QSS_PROPERTY_UNKNOWN ? qss::Atom{ property } : qss::Atom{ lexer.string(key) };
+    }
+}
+
+void qss::PropertyBlock::parse(const Lexer &lexer, const Lexer::Token &token)
+{
+    QSS_SCOPE(BLOCK_PARSE);
+    m_generation = nextGeneration();
+
+    // The lexer splits statements on the first unquoted ':' and ';', so values
+    // such as url(:/icon.png) or quoted text containing delimiters stay whole
+    for (qsizetype i = 0; i < token.declarationCount; ++i)
+    {
+        const auto& declaration = lexer.declaration(token, i);
+        set(KeyAtom(lexer, declaration.key), { lexer.string(declaration.value), true });
+    }
+}
+
+void qss::PropertyBlock::parse(const Utf8Lexer &lexer, const Lexer::Token &token)
+{
+    QSS_SCOPE(BLOCK_PARSE);
+    m_generation = nextGeneration();
+
+    for (qsizetype i = 0; i < token.declarationCount; ++i)
+    {
+        const auto& declaration = lexer.declaration(token, i);
+        set(KeyAtom(lexer, declaration.key), { lexer.string(declaration.value), true });
     }
 }
 
 QString qss::PropertyBlock::toString() const
 {
-    QString result;
+    return Writer::toString(*this);
+}
 
-    for (auto const& pair : m_params)
+std::size_t qss::PropertyBlock::size() const noexcept
+{
+    return m_params.size();
+}
+
+QString qss::PropertyBlock::value(const QString &key) const
+{
+    auto param = typedValue(key);
+    return param != nullptr ? param->toString() : QString{};
+}
+
+QString qss::PropertyBlock::value(Property property) const
+{
+    auto param = typedValue(property);
+    return param != nullptr ? param->toString() : QString{};
+}
+
+const qss::PropertyValue* qss::PropertyBlock::typedValue(const QString &key) const
+{
+    auto index = indexOf(key);
+    return index != npos ? &m_params[index].second.first : nullptr;
+}
+
+const qss::PropertyValue* qss::PropertyBlock::typedValue(Property property) const
+{
+    auto index = property < QSS_PROPERTY_COUNT ? indexOf(Atom{ property }) : npos;
+    return index != npos ? &m_params[index].second.first : nullptr;
+}
+
+qss::AtomList qss::PropertyBlock::unknownParams() const
+{
+    // Known names were resolved when inserted, so this is a flag test per
+    // param; qproperty-* assignments are valid custom names and not reported
+    AtomList result;
+
+    for (const auto& param : m_params)
     {
-        if (pair.second.second)
+        if (param.first.property() == QSS_PROPERTY_UNKNOWN && !param.first.toString().startsWith("qproperty-"))
         {
-            result += "\t" + pair.first + Delimiters.at(QSS_PSEUDO_CLASS_DELIMITER);
-            result += " " + pair.second.first + Delimiters.at(QSS_STATEMENT_END_DELIMITER) + "\n";
+            result.push_back(param.first);
         }
     }
 
     return result;
 }
 
-std::size_t qss::PropertyBlock::size() const noexcept
+std::size_t qss::PropertyBlock::indexOf(Atom key) const
 {
-    return m_params.size();
+    if (m_index)
+    {
+        const auto property = key.property();
+
+        if (property != QSS_PROPERTY_UNKNOWN)
+        {
+            return m_index->slots[property] != 0 ? m_index->slots[property] - 1u : npos;
+        }
+
+        auto itr = m_index->custom.find(key);
+        return itr != m_index->custom.cend() ? itr->second : npos;
+    }
+
+    // A few contiguous integers; compilers vectorize this scan
+    auto itr = std::find(m_keys.cbegin(), m_keys.cend(), key.id());
+    return itr != m_keys.cend() ? static_cast<std::size_t>(itr - m_keys.cbegin()) : npos;
+}
+
+std::size_t qss::PropertyBlock::indexOf(const QString &key) const
+{
+    const auto property = propertyFromName(QStringView{ key });
+
+    if (property != QSS_PROPERTY_UNKNOWN)
+    {
+        return indexOf(Atom{ property });
+    }
+
+    // A name that was never interned cannot be a key of any block
+    auto atom = Atom::find(key);
+    return atom ? indexOf(*atom) : npos;
+}
+
+void qss::PropertyBlock::set(Atom key, InvalidablePair<PropertyValue> value)
+{
+    auto index = indexOf(key);
+
+    if (index != npos)
+    {
+        m_hash -= hash(m_params[index]);
+        m_params[index].second = std::move(value);
+        m_hash += hash(m_params[index]);
+        return;
+    }
+
+    m_params.emplace_back(key, std::move(value));
+    m_keys.push_back(key.id());
+    m_hash += hash(m_params.back());
+
+    if (m_index)
+    {
+        addToIndex(m_params.size() - 1);
+    }
+    else if (m_params.size() > IndexThreshold)
+    {
+        rebuildIndex();
+    }
+}
+
+void qss::PropertyBlock::enable(std::size_t index, bool enable)
+{
+    m_hash -= hash(m_params[index]);
+    m_params[index].second.second = enable;
+    m_hash += hash(m_params[index]);
+}
+
+void qss::PropertyBlock::erase(std::size_t index)
+{
+    m_hash -= hash(m_params[index]);
+    m_params.erase(m_params.begin() + static_cast<std::ptrdiff_t>(index));
+    m_keys.erase(m_keys.begin() + static_cast<std::ptrdiff_t>(index));
+
+    // Every later param moved down by one, so the index is rebuilt whole
+    if (m_index)
+    {
+        rebuildIndex();
+    }
+}
+
+void qss::PropertyBlock::addToIndex(std::size_t index)
+{
+    const auto& key = m_params[index].first;
+    const auto property = key.property();
+
+    if (property != QSS_PROPERTY_UNKNOWN)
+    {
+        m_index->slots[property] = static_cast<quint32>(index + 1);
+    }
+    else
+    {
+        m_index->custom.emplace(key, index);
+    }
+}
+
+void qss::PropertyBlock::rebuildIndex()
+{
+    if (m_params.size() <= IndexThreshold)
+    {
+        m_index.reset();
+        return;
+    }
+
+    m_index.reset(new Index{});
+
+    for (std::size_t i = 0; i < m_params.size(); ++i)
+    {
+        addToIndex(i);
+    }
+}
+
+quint64 qss::PropertyBlock::hash(const Param& param) noexcept
+{
+    // Summed over the params, so the block hash ignores insertion order
+    auto result = hashCombine(param.first.hash(), qHash(param.second.first.toString()));
+    return hashCombine(result, param.second.second ? 1 : 0);
 }
 
 bool qss::operator==(const PropertyBlock & lhs, const PropertyBlock & rhs)
 {
-    return lhs.toString() == rhs.toString();
+    if (lhs.hash() != rhs.hash() || lhs.size() != rhs.size())
+    {
+        return false;
+    }
+
+    // Insertion order is not part of a block's value
+    for (const auto& param : lhs.m_params)
+    {
+        auto index = rhs.indexOf(param.first);
+
+        if (index == PropertyBlock::npos || rhs.m_params[index].second.second != param.second.second ||
+            rhs.m_params[index].second.first.toString() != param.second.first.toString())
+        {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 qss::PropertyBlock qss::operator+(const PropertyBlock & lhs, const PropertyBlock & rhs)
@@ -154,3 +427,9 @@ qss::PropertyBlock qss::operator+(const PropertyBlock & lhs, const PropertyBlock
     sum += rhs;
     return sum;
 }
+
+qss::PropertyBlock qss::operator+(PropertyBlock && lhs, const PropertyBlock & rhs)
+{
+    lhs += rhs;
+    return std::move(lhs);
+}
@@ -1,4 +1,6 @@
 #include "../include/qssselector.h"
+#include "../include/qsswriter.h"
+#include "../include/qssinstrument.h"
 
 #include <QRegularExpression>
 
@@ -7,12 +9,28 @@ qss::Selector::Selector(const QString & str)
     parse(str);
 }
 
+qss::Selector::Selector(const QString &str, const allocator_type &allocator) : Selector{ allocator }
+{
+    parse(str);
+}
+
 qss::Selector& qss::Selector::operator=(const Selector &selector)
 {
     m_fragments = selector.m_fragments;
     return *this;
 }
 
+qss::Selector& qss::Selector::operator=(Selector &&selector)
+{
+    if (this == &selector)
+    {
+        return *this;
+    }
+
+    m_fragments = std::move(selector.m_fragments);
+    return *this;
+}
+
 qss::Selector& qss::Selector::addChild(const SelectorElement &fragment)
 {
     return append(fragment, SelectorElement::CHILD);
@@ -55,25 +73,56 @@ qss::Selector& qss::Selector::addSibling(const QString &fragment)
 
 qss::Selector& qss::Selector::append(const QString &fragment, SelectorElement::PositionType type)
 {
-    m_fragments.emplace_back(fragment);
-    m_fragments.back().m_position = type;
-    return *this;
+    return emplace(type, fragment);
 }
 
 qss::Selector& qss::Selector::append(const SelectorElement &fragment, SelectorElement::PositionType type)
 {
-    m_fragments.push_back(fragment);
-    m_fragments.back().m_position = type;
-    return *this;
+    return emplace(type, fragment);
+}
+
+qss::Selector& qss::Selector::append(SelectorElement &&fragment, SelectorElement::PositionType type)
+{
+    return emplace(type, std::move(fragment));
 }
 
 void qss::Selector::parse(const QString &selector)
 {
-    auto addFragment = [this](const QStringList& list, int index, SelectorElement& fragment, SelectorElement::PositionType pos)
+    parse(selector, nullptr);
+}
+
+bool qss::Selector::parse(const QString &selector, int &error)
+{
+    return parse(selector, &error);
+}
+
+bool qss::Selector::parse(const QString &selector, int *error)
+{
+    QSS_SCOPE(SELECTOR_PARSE);
+    // Elements are parsed in place, so they draw from the selector's resource
+    auto addFragment = [this, error](const QStringList& list, int index, SelectorElement::PositionType pos)
     {
-        fragment.parse(list[index]);
-        fragment.m_position = pos;
-        m_fragments.push_back(fragment);
+        auto& fragment = m_fragments.emplace_back();
+        auto parsed = false;
+
+        try
+        {
+            parsed = fragment.parse(list[index], error);
+        }
+        catch (...)
+        {
+            m_fragments.pop_back();
+            throw;
+        }
+
+        if (!parsed)
+        {
+            m_fragments.pop_back();
+            return false;
+        }
+
+        fragment.setPosition(pos);
+        return true;
     };
 
     auto str = selector.trimmed();
@@ -84,51 +133,70 @@ void qss::Selector::parse(const QString &selector)
 
         QRegularExpression regex("`+");
         auto parts = str.split(regex, Qt::SkipEmptyParts);
-        SelectorElement select;
-        addFragment(parts, 0, select, SelectorElement::PARENT);
+        if (!addFragment(parts, 0, SelectorElement::PARENT))
+        {
+            return false;
+        }
 
         for (int i = 1; i < parts.size();)
         {
-            SelectorElement select;
-
             if (Combinators.count(parts[i]) != 0)
             {
-                if (parts.size() > (i + 1))
+                if (parts.size() <= (i + 1))
                 {
-                    addFragment(parts, i + 1, select, Combinators.at(parts[i]));
-                    i += 2;
+                    return Exception::raise(error, Exception::SELECTOR_INVALID, parts[i]);
                 }
-                else
+                else if (!addFragment(parts, i + 1, Combinators.at(parts[i])))
                 {
-                    throw Exception{ Exception::SELECTOR_INVALID, parts[i] };
+                    return false;
                 }
+
+                i += 2;
             }
             else if (Delimiters.at(QSS_BLOCK_START_DELIMITER) == parts[i].trimmed())
             {
                 i++;
                 continue;
             }
+            else if (!addFragment(parts, i, SelectorElement::DESCENDANT))
+            {
+                return false;
+            }
             else
             {
-                addFragment(parts, i, select, SelectorElement::DESCENDANT);
                 i++;
             }
         }
     }
+
+    return true;
 }
 
 QString qss::Selector::toString() const
 {
-    QString result;
+    return Writer::toString(*this);
+}
+
+qss::Specificity qss::Selector::specificity(int first, int last) const
+{
+    Specificity result;
+    last = last < 0 ? static_cast<int>(m_fragments.size()) - 1 : last;
 
-    if (m_fragments.size() > 0)
+    for (auto i = first; i <= last; ++i)
     {
-        result = m_fragments[0].toString();
+        result += m_fragments[i].specificity();
+    }
 
-        for (int i = 1; i < m_fragments.size(); ++i)
-        {
-            result += " " + m_fragments[i].toString();
-        }
+    return result;
+}
+
+quint64 qss::Selector::hash() const noexcept
+{
+    quint64 result = m_fragments.size();
+
+    for (const auto& fragment : m_fragments)
+    {
+        result = hashCombine(result, fragment.hash());
     }
 
     return result;
@@ -136,22 +204,48 @@ QString qss::Selector::toString() const
 
 bool qss::operator==(const Selector &lhs, const Selector &rhs)
 {
-    return lhs.toString() == rhs.toString();
+    return lhs.m_fragments == rhs.m_fragments;
 }
 
 void qss::Selector::preProcess(QString &str)
 {
-    int quotes = str[0] == '"';
+    // Whitespace outside quotes and params becomes a separator, and so do
+    // both sides of a combinator, which may be written without spaces
+    QString result;
+    result.reserve(str.size() + 8);
+
+    int quotes = 0;
+    int brackets = 0;
 
-    for (int i = 1; i < str.size(); ++i)
+    for (int i = 0; i < str.size(); ++i)
     {
-        if (str[i].isSpace() && (quotes % 2 == 0))
+        const auto c = str[i];
+        const auto plain = quotes % 2 == 0 && brackets == 0;
+
+        if (plain && c.isSpace())
         {
-            str[i] = PreProcessChar;
+            result += QChar(PreProcessChar);
         }
+        else if (plain && (c == ',' || c == '>' || c == '~' || c == '+'))
+        {
+            result += QChar(PreProcessChar);
+            result += c;
+            result += QChar(PreProcessChar);
+        }
+        else
+        {
+            result += c;
+        }
+
+        quotes += (c == '"' && (i == 0 || str[i - 1] != '\\'));
 
-        quotes += (str[i] == '"' && str[i - 1] != '\\');
+        if (quotes % 2 == 0)
+        {
+            brackets += c == '[' ? 1 : (c == ']' ? -1 : 0);
+        }
     }
+
+    str = result;
 }
 
 const std::unordered_map<QString, qss::SelectorElement::PositionType, qss::QStringHasher> qss::Selector::Combinators {
@@ -1,10 +1,41 @@
 #include "../include/qssselectorelement.h"
+#include "../include/qsswriter.h"
 
 qss::SelectorElement::SelectorElement(const QString & str)
 {
     parse(str);
 }
 
+qss::SelectorElement::SelectorElement(const QString &str, const allocator_type &allocator) : SelectorElement{ allocator }
+{
+    parse(str);
+}
+
+qss::SelectorElement::SelectorElement(const SelectorElement &element, const allocator_type &allocator)
+    : m_name{ element.m_name }, m_id{ element.m_id }, m_subControl{ element.m_subControl },
+      m_psuedoClass{ element.m_psuedoClass }, m_params{ element.m_params, allocator },
+      m_position{ element.m_position }, m_classes{ element.m_classes, allocator }, m_hash{ element.m_hash }
+{
+}
+
+qss::SelectorElement::SelectorElement(SelectorElement &&element)
+    : m_name{ element.m_name }, m_id{ element.m_id }, m_subControl{ element.m_subControl },
+      m_psuedoClass{ std::move(element.m_psuedoClass) }, m_params{ std::move(element.m_params) },
+      m_position{ element.m_position }, m_classes{ std::move(element.m_classes) }, m_hash{ element.m_hash }
+{
+    element.m_hash = 0;
+}
+
+// Takes the containers over when the resources match and moves their
+// elements into this allocator's resource otherwise
+qss::SelectorElement::SelectorElement(SelectorElement &&element, const allocator_type &allocator)
+    : m_name{ element.m_name }, m_id{ element.m_id }, m_subControl{ element.m_subControl },
+      m_psuedoClass{ std::move(element.m_psuedoClass) }, m_params{ std::move(element.m_params), allocator },
+      m_position{ element.m_position }, m_classes{ std::move(element.m_classes), allocator }, m_hash{ element.m_hash }
+{
+    element.m_hash = 0;
+}
+
 qss::SelectorElement& qss::SelectorElement::operator=(const SelectorElement &fragment)
 {
     m_psuedoClass = fragment.m_psuedoClass;
@@ -12,18 +43,42 @@ qss::SelectorElement& qss::SelectorElement::operator=(const SelectorElement &fra
     m_params = fragment.m_params;
     m_id = fragment.m_id;
     m_position = fragment.m_position;
+    m_subControl = fragment.m_subControl;
+    m_classes = fragment.m_classes;
+    m_hash = fragment.m_hash;
+    return *this;
+}
+
+qss::SelectorElement& qss::SelectorElement::operator=(SelectorElement &&fragment)
+{
+    if (this == &fragment)
+    {
+        return *this;
+    }
+
+    m_psuedoClass = std::move(fragment.m_psuedoClass);
+    m_name = fragment.m_name;
+    m_params = std::move(fragment.m_params);
+    m_id = fragment.m_id;
+    m_position = fragment.m_position;
+    m_subControl = fragment.m_subControl;
+    m_classes = std::move(fragment.m_classes);
+    m_hash = fragment.m_hash;
+    fragment.m_hash = 0;
     return *this;
 }
 
 qss::SelectorElement& qss::SelectorElement::select(const QString &sel)
 {
     m_name = sel.trimmed();
+    rehash();
     return *this;
 }
 
 qss::SelectorElement& qss::SelectorElement::on(const QString &key, const QString &value)
 {
     m_params[key.trimmed()] = value;
+    rehash();
     return *this;
 }
 
@@ -33,76 +88,75 @@ qss::SelectorElement& qss::SelectorElement::on(const QStringPairs &params)
     {
         m_params[param.first.trimmed()] = param.second;
     }
+    rehash();
     return *this;
 }
 
 qss::SelectorElement& qss::SelectorElement::sub(const QString &name)
 {
     m_subControl = name;
+    rehash();
     return *this;
 }
 
 qss::SelectorElement& qss::SelectorElement::when(const QString &pcl)
 {
     m_psuedoClass = pcl.trimmed();
+    rehash();
     return *this;
 }
 
 qss::SelectorElement& qss::SelectorElement::name(const QString &str)
 {
     m_id = str.trimmed();
+    rehash();
     return *this;
 }
 
-void qss::SelectorElement::parse(const QString &str)
+qss::SelectorElement& qss::SelectorElement::addClass(const QString &cl)
 {
-    auto selector = str.trimmed();
-
-    if (selector.size() != 0)
-    {
-        auto remaining = extractSubControlAndPsuedoClass(selector);
-        remaining = extractParams(remaining);
-        extractNameAndSelector(remaining);
-    }
+    m_classes.push_back(cl.trimmed());
+    rehash();
+    return *this;
 }
 
-QString qss::SelectorElement::toString() const
+void qss::SelectorElement::parse(const QString &str)
 {
-    QString result;
-
-    if (m_name.size() > 0)
-    {
-        result += m_position != PARENT ? Combinators.at(m_position) + " " + m_name : m_name;
-    }
+    parse(str, nullptr);
+}
 
-    if (m_id.size() > 0)
-    {
-        result += Delimiters.at(QSS_ID_DELIMITER) + m_id;
-    }
+bool qss::SelectorElement::parse(const QString &str, int &error)
+{
+    return parse(str, &error);
+}
 
-    for (const auto& cl : m_classes)
-    {
-        result += Delimiters.at(QSS_CLASS_DELIMITER) + cl;
-    }
+bool qss::SelectorElement::parse(const QString &str, int *error)
+{
+    auto selector = str.trimmed();
+    auto parsed = true;
 
-    for (auto const& pair : m_params)
+    try
     {
-        result += Delimiters.at(QSS_SELECT_PARAM_START_DELIMITER) +
-                pair.first + Delimiters.at(QSS_PARAM_DELIMITER) +
-                QuotedString(pair.second) + Delimiters.at(QSS_SELECT_PARAM_END_DELIMITER);
+        if (selector.size() != 0)
+        {
+            auto remaining = extractSubControlAndPsuedoClass(selector);
+            parsed = extractParams(remaining, error) && extractNameAndSelector(remaining, error);
+        }
     }
-
-    if (m_subControl.size() > 0)
+    catch (...)
     {
-        result += Delimiters.at(QSS_SUB_CONTROL_DELIMITER) + m_subControl;
+        // Whatever was parsed before the error stays, hashed
+        rehash();
+        throw;
     }
 
-    if (m_psuedoClass.size() > 0)
-    {
-        result += Delimiters.at(QSS_PSEUDO_CLASS_DELIMITER) + m_psuedoClass;
-    }
+    rehash();
+    return parsed;
+}
 
-    return result;
+QString qss::SelectorElement::toString() const
+{
+    return Writer::toString(*this);
 }
 
 bool qss::SelectorElement::isGeneralizedFrom(const SelectorElement &fragment) const
@@ -165,9 +219,21 @@ bool qss::SelectorElement::isSpecificThan(const SelectorElement &fragment) const
     return fragment.isGeneralizedFrom(*this);
 }
 
+qss::Specificity qss::SelectorElement::specificity() const
+{
+    Specificity result;
+    result.ids = m_id.isEmpty() ? 0 : 1;
+    result.classes = static_cast<int>(m_classes.size() + m_params.size());
+    result.classes += static_cast<int>(m_psuedoClass.split(Delimiters.at(QSS_PSEUDO_CLASS_DELIMITER), Qt::SkipEmptyParts).size());
+    result.types = (m_name.isEmpty() || m_name == "*") ? 0 : 1;
+    result.types += m_subControl.isEmpty() ? 0 : 1;
+    return result;
+}
+
 QString qss::SelectorElement::value(const QString & key) const
 {
-    auto itr = m_params.find(key);
+    auto atom = Atom::find(key);
+    auto itr = atom ? m_params.find(*atom) : m_params.cend();
 
     if (itr != m_params.cend())
     {
@@ -200,13 +266,13 @@ QString qss::SelectorElement::extractSubControlAndPsuedoClass(const QString &str
     return parts[0];
 }
 
-QString qss::SelectorElement::extractParams(const QString &str)
+bool qss::SelectorElement::extractParams(QString &str, int *error)
 {
     auto parts = str.split(Delimiters.at(QSS_SELECT_PARAM_START_DELIMITER), Qt::SkipEmptyParts);
 
     if (parts.size() == 1 && str.indexOf(Delimiters.at(QSS_SELECT_PARAM_START_DELIMITER)) != -1)
     {
-        throw Exception{ Exception::ILL_FORMED_HEADER_PARAM, str };
+        return Exception::raise(error, Exception::ILL_FORMED_HEADER_PARAM, str);
     }
 
     if (parts.size() > 1)
@@ -216,7 +282,7 @@ QString qss::SelectorElement::extractParams(const QString &str)
             auto params = parts[i].split(Delimiters.at(QSS_PARAM_DELIMITER));
             if (params.size() != 2)
             {
-                throw Exception{ Exception::HEADER_PARAM_INVALID, parts[i] };
+                return Exception::raise(error, Exception::HEADER_PARAM_INVALID, parts[i]);
             }
             else
             {
@@ -229,10 +295,11 @@ QString qss::SelectorElement::extractParams(const QString &str)
     }
 
     // TODO Is this legitimate or a temporary workaround?
-    return parts.size() > 0 ? parts[0] : "";
+    str = parts.size() > 0 ? parts[0] : "";
+    return true;
 }
 
-void qss::SelectorElement::extractNameAndSelector(const QString &str)
+bool qss::SelectorElement::extractNameAndSelector(const QString &str, int *error)
 {
     auto select = str.split(Delimiters.at(QSS_ID_DELIMITER));
     auto parts = select[0].split(Delimiters.at(QSS_CLASS_DELIMITER), Qt::SkipEmptyParts);
@@ -255,13 +322,54 @@ void qss::SelectorElement::extractNameAndSelector(const QString &str)
     }
     else if (select.size() > 2)
     {
-        throw Exception{ Exception::MULTIPLE_IDS, str };
+        return Exception::raise(error, Exception::MULTIPLE_IDS, str);
     }
+
+    return true;
+}
+
+quint64 qss::SelectorElement::hash() const noexcept
+{
+    return m_hash != 0 ? m_hash : computeHash();
+}
+
+quint64 qss::SelectorElement::computeHash() const noexcept
+{
+    // Classes and params are summed, so their order does not matter
+    quint64 classes = 0;
+    quint64 params = 0;
+
+    for (const auto& cl : m_classes)
+    {
+        classes += hashMix(cl.hash());
+    }
+
+    for (const auto& pair : m_params)
+    {
+        params += hashCombine(pair.first.hash(), qHash(pair.second));
+    }
+
+    quint64 result = hashCombine(m_name.hash(), m_id.hash());
+    result = hashCombine(result, m_subControl.hash());
+    result = hashCombine(result, qHash(m_psuedoClass));
+    result = hashCombine(result, static_cast<quint64>(m_position));
+    result = hashCombine(result, classes);
+    result = hashCombine(result, params);
+    return result != 0 ? result : 1;
 }
 
 bool qss::operator==(const SelectorElement &lhs, const SelectorElement &rhs)
 {
-    return lhs.toString() == rhs.toString();
+    if (lhs.hash() != rhs.hash() || lhs.m_name != rhs.m_name || lhs.m_id != rhs.m_id ||
+        lhs.m_subControl != rhs.m_subControl || lhs.m_position != rhs.m_position ||
+        lhs.m_psuedoClass != rhs.m_psuedoClass || lhs.m_params != rhs.m_params ||
+        lhs.m_classes.size() != rhs.m_classes.size())
+    {
+        return false;
+    }
+
+    // ".a.b" and ".b.a" select the same widgets
+    return std::is_permutation(lhs.m_classes.cbegin(), lhs.m_classes.cend(), rhs.m_classes.cbegin());
 }
 
 const std::unordered_map<int, QString> qss::SelectorElement::Combinators{
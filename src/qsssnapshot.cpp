@@ -0,0 +1,510 @@
+#include "../include/qsssnapshot.h"
+#include "../include/qsswriter.h"
+
+#include <algorithm>
+
+// Leaves hold entries and inner nodes children. Every leaf but the last is
+// full, so an index picks its child at each level by its bits alone.
+struct qss::Snapshot::Node
+{
+    std::vector<std::shared_ptr<const Node>> children;
+    std::vector<Entry>                       entries;
+};
+
+// Hashes are spread over children by Bits of the hash per level, lowest
+// first, and a leaf holds at most Width buckets unless the hash is used up
+struct qss::Snapshot::IndexNode
+{
+    std::vector<std::shared_ptr<const IndexNode>> children;    // Width slots, null where empty; none in a leaf
+    std::vector<Positions>                        buckets;
+};
+
+qss::Snapshot::ConstItr::ConstItr(const Snapshot* snapshot, std::size_t index)
+    : m_snapshot{ snapshot }, m_index{ index }, m_entry{ snapshot->leaf(index) }
+{
+}
+
+qss::Snapshot::ConstItr& qss::Snapshot::ConstItr::operator++()
+{
+    ++m_index;
+    m_entry = m_index % Width == 0 ? m_snapshot->leaf(m_index) : m_entry + 1;
+    return *this;
+}
+
+qss::Snapshot::Snapshot(const Document &document)
+{
+    std::vector<Entry> sealed;
+    sealed.reserve(document.totalFragments());
+
+    for (const auto& pair : document)
+    {
+        sealed.push_back(seal(Fragment{ pair.first }, pair.second));
+    }
+
+    build(std::move(sealed));
+}
+
+qss::Snapshot::Snapshot(Document &&document)
+{
+    std::vector<Entry> sealed;
+    sealed.reserve(document.totalFragments());
+
+    for (auto& pair : document)
+    {
+        sealed.push_back(seal(std::move(pair.first), pair.second));
+    }
+
+    build(std::move(sealed));
+}
+
+qss::Snapshot qss::Snapshot::withFragment(std::size_t index, Fragment fragment) const
+{
+    auto sealed = seal(std::move(fragment), isEnabled(index));
+    const auto before = (*this)[index].selector().hash();
+    const auto after = sealed.fragment->selector().hash();
+
+    Snapshot next;
+    next.m_root = assign(*m_root, m_shift, index, std::move(sealed));
+    next.m_index = before == after ? m_index : indexed(indexed(m_index.get(), 0, before, index, false).get(), 0, after, index, true);
+    next.m_size = m_size;
+    next.m_shift = m_shift;
+    return next;
+}
+
+qss::Snapshot qss::Snapshot::withEnabled(std::size_t index, bool enable) const
+{
+    Snapshot next;
+    next.m_root = assign(*m_root, m_shift, index, Entry{ fragment(index), enable });
+    next.m_index = m_index;
+    next.m_size = m_size;
+    next.m_shift = m_shift;
+    return next;
+}
+
+qss::Snapshot qss::Snapshot::withAppended(Fragment fragment, bool enabled) const
+{
+    auto sealed = seal(std::move(fragment), enabled);
+
+    Snapshot next;
+    next.m_index = indexed(m_index.get(), 0, sealed.fragment->selector().hash(), m_size, true);
+    next.m_size = m_size + 1;
+    next.m_shift = m_shift;
+
+    if (!m_root)
+    {
+        next.m_root = push(nullptr, 0, 0, std::move(sealed));
+    }
+    else if (m_size == std::size_t{ 1 } << (m_shift + Bits))
+    {
+        // The tree is full, so it gains a level with the old root on its left
+        auto root = std::make_shared<Node>();
+        root->children.push_back(m_root);
+        root->children.push_back(push(nullptr, m_shift, m_size, std::move(sealed)));
+        next.m_root = std::move(root);
+        next.m_shift = m_shift + Bits;
+    }
+    else
+    {
+        next.m_root = push(m_root.get(), m_shift, m_size, std::move(sealed));
+    }
+
+    return next;
+}
+
+qss::Snapshot qss::Snapshot::withInserted(std::size_t index, Fragment fragment, bool enabled) const
+{
+    if (index == m_size)
+    {
+        return withAppended(std::move(fragment), enabled);
+    }
+
+    auto shared = entries();
+    shared.insert(shared.begin() + static_cast<std::ptrdiff_t>(index), seal(std::move(fragment), enabled));
+    Snapshot next;
+    next.build(std::move(shared));
+    return next;
+}
+
+qss::Snapshot qss::Snapshot::withoutFragment(std::size_t index) const
+{
+    auto shared = entries();
+    shared.erase(shared.begin() + static_cast<std::ptrdiff_t>(index));
+    Snapshot next;
+    next.build(std::move(shared));
+    return next;
+}
+
+std::vector<std::size_t> qss::Snapshot::find(const QString &selector) const
+{
+    const Selector key{ selector };
+    std::vector<std::size_t> result;
+
+    if (const auto* found = positions(key.hash()))
+    {
+        // Distinct selectors may share a hash
+        for (auto index : *found)
+        {
+            if ((*this)[index].selector() == key)
+            {
+                result.push_back(index);
+            }
+        }
+    }
+
+    return result;
+}
+
+QString qss::Snapshot::value(const QString &selector, const QString &key) const
+{
+    // The last enabled declaration wins, as in Document::value
+    auto positions = find(selector);
+
+    for (auto itr = positions.crbegin(); itr != positions.crend(); ++itr)
+    {
+        const auto& found = entry(*itr);
+        const auto* value = found.fragment->block().typedValue(key);
+
+        if (found.enabled && value != nullptr)
+        {
+            return value->toString();
+        }
+    }
+
+    return QString{};
+}
+
+qss::Document qss::Snapshot::toDocument() const
+{
+    // Appended as they are, like a parse, so repeated selectors are not merged
+    Document document;
+
+    for (const auto& entry : *this)
+    {
+        document.m_fragments.emplace_back(*entry.fragment, entry.enabled);
+    }
+
+    document.reindex();
+
+    return document;
+}
+
+QString qss::Snapshot::toString() const
+{
+    return Writer::toString(*this);
+}
+
+qss::Snapshot::Entry qss::Snapshot::seal(Fragment &&fragment, bool enabled)
+{
+    // Taken out of the resource it came from, which may be an arena that
+    // does not outlive the document
+    auto sealed = std::make_shared<Fragment>(std::move(fragment), Fragment::allocator_type{});
+    sealed->hash();
+
+    for (auto itr = sealed->block().cbegin(); itr != sealed->block().cend(); ++itr)
+    {
+        itr->second.first.type();
+    }
+
+    return Entry{ std::move(sealed), enabled };
+}
+
+std::shared_ptr<const qss::Snapshot::Node> qss::Snapshot::assign(const Node &node, int shift, std::size_t index, Entry &&entry)
+{
+    auto copy = std::make_shared<Node>(node);
+    const auto slot = (index >> shift) & (Width - 1);
+
+    if (shift == 0)
+    {
+        copy->entries[slot] = std::move(entry);
+    }
+    else
+    {
+        copy->children[slot] = assign(*copy->children[slot], shift - Bits, index, std::move(entry));
+    }
+
+    return copy;
+}
+
+// Adds the entry at index, the end of the tree, copying the rightmost path
+// or starting a new one where node is null
+std::shared_ptr<const qss::Snapshot::Node> qss::Snapshot::push(const Node *node, int shift, std::size_t index, Entry &&entry)
+{
+    auto copy = node != nullptr ? std::make_shared<Node>(*node) : std::make_shared<Node>();
+
+    if (shift == 0)
+    {
+        copy->entries.push_back(std::move(entry));
+        return copy;
+    }
+
+    const auto slot = (index >> shift) & (Width - 1);
+
+    if (slot < copy->children.size())
+    {
+        copy->children[slot] = push(copy->children[slot].get(), shift - Bits, index, std::move(entry));
+    }
+    else
+    {
+        copy->children.push_back(push(nullptr, shift - Bits, index, std::move(entry)));
+    }
+
+    return copy;
+}
+
+std::shared_ptr<const qss::Snapshot::IndexNode> qss::Snapshot::buildIndex(std::vector<Positions> &&buckets, int shift)
+{
+    auto node = std::make_shared<IndexNode>();
+
+    if (buckets.size() <= Width || shift >= 64)
+    {
+        node->buckets = std::move(buckets);
+        return node;
+    }
+
+    std::vector<std::vector<Positions>> slots(Width);
+
+    for (auto& bucket : buckets)
+    {
+        slots[(bucket.hash >> shift) & (Width - 1)].push_back(std::move(bucket));
+    }
+
+    for (auto& slot : slots)
+    {
+        node->children.push_back(slot.empty() ? nullptr : buildIndex(std::move(slot), shift + Bits));
+    }
+
+    return node;
+}
+
+// Adds index to the bucket of hash or removes it, copying the path to the
+// leaf holding it, or starting one where node is null
+std::shared_ptr<const qss::Snapshot::IndexNode> qss::Snapshot::indexed(const IndexNode *node, int shift, quint64 hash, std::size_t index, bool add)
+{
+    if (node != nullptr && !node->children.empty())
+    {
+        auto copy = std::make_shared<IndexNode>(*node);
+        auto& child = copy->children[(hash >> shift) & (Width - 1)];
+        child = indexed(child.get(), shift + Bits, hash, index, add);
+        return copy;
+    }
+
+    auto buckets = node != nullptr ? node->buckets : std::vector<Positions>{};
+    auto bucket = std::find_if(buckets.begin(), buckets.end(), [hash](const Positions& positions) {
+        return positions.hash == hash;
+    });
+
+    if (add && bucket == buckets.end())
+    {
+        buckets.push_back(Positions{ hash, { index } });
+    }
+    else if (add)
+    {
+        bucket->indices.insert(std::upper_bound(bucket->indices.begin(), bucket->indices.end(), index), index);
+    }
+    else if (bucket != buckets.end())
+    {
+        bucket->indices.erase(std::find(bucket->indices.begin(), bucket->indices.end(), index));
+
+        if (bucket->indices.empty())
+        {
+            buckets.erase(bucket);
+        }
+    }
+
+    // A leaf that outgrows Width buckets splits here
+    return buildIndex(std::move(buckets), shift);
+}
+
+const std::vector<std::size_t>* qss::Snapshot::positions(quint64 hash) const
+{
+    const auto* node = m_index.get();
+
+    for (auto shift = 0; node != nullptr && !node->children.empty(); shift += Bits)
+    {
+        node = node->children[(hash >> shift) & (Width - 1)].get();
+    }
+
+    if (node != nullptr)
+    {
+        for (const auto& bucket : node->buckets)
+        {
+            if (bucket.hash == hash)
+            {
+                return &bucket.indices;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+const qss::Snapshot::Entry& qss::Snapshot::entry(std::size_t index) const
+{
+    return leaf(index)[index & (Width - 1)];
+}
+
+// The entries of the leaf holding index, or null past the end
+const qss::Snapshot::Entry* qss::Snapshot::leaf(std::size_t index) const
+{
+    if (index >= m_size)
+    {
+        return nullptr;
+    }
+
+    const auto* node = m_root.get();
+
+    for (auto shift = m_shift; shift > 0; shift -= Bits)
+    {
+        node = node->children[(index >> shift) & (Width - 1)].get();
+    }
+
+    return node->entries.data();
+}
+
+std::vector<qss::Snapshot::Entry> qss::Snapshot::entries() const
+{
+    return std::vector<Entry>(cbegin(), cend());
+}
+
+void qss::Snapshot::build(std::vector<Entry> &&entries)
+{
+    m_size = entries.size();
+    m_shift = 0;
+    m_root.reset();
+    m_index.reset();
+
+    if (entries.empty())
+    {
+        return;
+    }
+
+    std::unordered_map<quint64, std::vector<std::size_t>> hashes;
+
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        hashes[entries[i].fragment->selector().hash()].push_back(i);
+    }
+
+    std::vector<Positions> buckets;
+    buckets.reserve(hashes.size());
+
+    for (auto& pair : hashes)
+    {
+        buckets.push_back(Positions{ pair.first, std::move(pair.second) });
+    }
+
+    m_index = buildIndex(std::move(buckets), 0);
+
+    std::vector<std::shared_ptr<const Node>> level;
+
+    for (std::size_t i = 0; i < entries.size(); i += Width)
+    {
+        auto leaf = std::make_shared<Node>();
+        const auto end = std::min(i + Width, entries.size());
+        leaf->entries.assign(std::make_move_iterator(entries.begin() + i), std::make_move_iterator(entries.begin() + end));
+        level.push_back(std::move(leaf));
+    }
+
+    while (level.size() > 1)
+    {
+        std::vector<std::shared_ptr<const Node>> parents;
+
+        for (std::size_t i = 0; i < level.size(); i += Width)
+        {
+            auto parent = std::make_shared<Node>();
+            const auto end = std::min(i + Width, level.size());
+            parent->children.assign(std::make_move_iterator(level.begin() + i), std::make_move_iterator(level.begin() + end));
+            parents.push_back(std::move(parent));
+        }
+
+        level = std::move(parents);
+        m_shift += Bits;
+    }
+
+    m_root = std::move(level.front());
+}
+
+qss::SharedDocument::SharedDocument(Snapshot snapshot) : m_current{ new Version{ std::move(snapshot) } }
+{
+}
+
+qss::SharedDocument::~SharedDocument()
+{
+    delete m_current.load();
+}
+
+qss::Snapshot qss::SharedDocument::snapshot() const
+{
+    const auto pinned = pin();
+    return pinned.version->snapshot;
+}
+
+void qss::SharedDocument::publish(Snapshot snapshot)
+{
+    std::lock_guard<std::mutex> lock{ m_writer };
+    install(std::move(snapshot));
+}
+
+std::size_t qss::SharedDocument::retiredVersions()
+{
+    std::lock_guard<std::mutex> lock{ m_writer };
+    return m_retired.size();
+}
+
+// Threads take stripes in turn, so up to Stripes readers share no counter
+std::size_t qss::SharedDocument::stripe()
+{
+    static std::atomic<std::size_t> next{ 0 };
+    thread_local const auto stripe = next.fetch_add(1, std::memory_order_relaxed) % Stripes;
+    return stripe;
+}
+
+// All sequentially consistent. The reader counts itself in the epoch it
+// read before loading the version, so a writer that later sees that count
+// at zero knows the reader has either pinned what it loaded or will load a
+// version current after the writer's own exchange.
+qss::SharedDocument::Pin qss::SharedDocument::pin() const
+{
+    const auto index = stripe();
+    auto& entering = m_entering[(m_epoch.load() & 1) * Stripes + index].value;
+    entering.fetch_add(1);
+    const auto* version = m_current.load();
+    version->pins[index].value.fetch_add(1);
+    entering.fetch_sub(1);
+    return Pin{ version, index };
+}
+
+int qss::SharedDocument::entering(quint64 epoch) const
+{
+    int total = 0;
+
+    for (std::size_t i = 0; i < Stripes; ++i)
+    {
+        total += m_entering[(epoch & 1) * Stripes + i].value.load();
+    }
+
+    return total;
+}
+
+void qss::SharedDocument::install(Snapshot &&snapshot)
+{
+    const auto epoch = m_epoch.load();
+    m_retired.push_back(Retired{ std::unique_ptr<const Version>{ m_current.exchange(new Version{ std::move(snapshot) }) }, epoch });
+
+    // Readers still loading in the previous epoch could hold a pointer they
+    // have not pinned yet. Once they are gone the epoch moves on, and a
+    // version replaced two epochs back can only be reached through its pins.
+    if (entering(epoch + 1) == 0)
+    {
+        m_epoch.store(epoch + 1);
+    }
+
+    const auto current = m_epoch.load();
+
+    m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(), [current](const Retired& retired) {
+        const auto& pins = retired.version->pins;
+        return retired.epoch + 2 <= current && std::all_of(pins.cbegin(), pins.cend(), [](const Counter& counter) {
+            return counter.value.load() == 0;
+        });
+    }), m_retired.end());
+}
@@ -0,0 +1,37 @@
+#include "../include/qssstaticdocument.h"
+
+void qss::detail::StaticSyntaxError(int code, const char* reason)
+{
+    // Only reached at runtime; during constant evaluation the call itself
+    // is the error
+    throw Exception{ code, reason };
+}
+
+qss::Document qss::StaticDocumentBase::toDocument(const StaticFragment* fragments, std::size_t fragmentCount, const StaticDeclaration* declarations)
+{
+    // Appended as written, like Document::parse, so repeated selectors are not merged
+    Document document;
+
+    for (std::size_t i = 0; i < fragmentCount; ++i)
+    {
+        const auto& source = fragments[i];
+        Fragment fragment;
+        fragment.select(QString::fromUtf8(source.selector.data(), static_cast<qsizetype>(source.selector.size())));
+
+        for (std::size_t j = 0; j < source.declarationCount; ++j)
+        {
+            const auto& declaration = declarations[source.firstDeclaration + j];
+            const auto key = declaration.property != QSS_PROPERTY_UNKNOWN ? Atom{ declaration.property } :
+                Atom{ QString::fromUtf8(declaration.key.data(), static_cast<qsizetype>(declaration.key.size())) };
+
+            fragment.block() += PropertyBlock::Param{ key,
+                std::make_pair(PropertyValue{ QString::fromUtf8(declaration.value.data(), static_cast<qsizetype>(declaration.value.size())) }, true) };
+        }
+
+        document.m_fragments.emplace_back(std::move(fragment), true);
+    }
+
+    document.reindex();
+
+    return document;
+}
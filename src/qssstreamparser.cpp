@@ -0,0 +1,44 @@
+#include "../include/qssstreamparser.h"
+
+qss::StreamParser& qss::StreamParser::feed(const QString& chunk)
+{
+    m_lexer.feed(chunk);
+    emitFragments();
+    return *this;
+}
+
+qss::StreamParser& qss::StreamParser::feed(QByteArrayView utf8)
+{
+    // The decoder holds back incomplete multi-byte sequences until the next chunk
+    QString chunk = m_decoder(utf8);
+    return feed(chunk);
+}
+
+qss::StreamParser& qss::StreamParser::read(QIODevice& device, qint64 chunkSize)
+{
+    for (auto bytes = device.read(chunkSize); !bytes.isEmpty(); bytes = device.read(chunkSize))
+    {
+        feed(QByteArrayView{ bytes });
+    }
+
+    return *this;
+}
+
+void qss::StreamParser::finish()
+{
+    m_lexer.finish();
+    emitFragments();
+}
+
+void qss::StreamParser::emitFragments()
+{
+    for (const auto& token : m_lexer.tokens())
+    {
+        Fragment fragment;
+        fragment.parse(m_lexer, token);
+        m_total++;
+        m_callback(fragment);
+    }
+
+    m_lexer.discardTokens();
+}
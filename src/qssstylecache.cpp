@@ -0,0 +1,107 @@
+#include "../include/qssstylecache.h"
+
+namespace
+{
+    // Every name is prefixed with its length, so no value can run into the
+    // next field however many separators it contains
+    QString Field(const QString& value)
+    {
+        return QString::number(value.size()) + QChar(':') + value;
+    }
+
+    QString SortedJoin(QStringList list)
+    {
+        std::sort(list.begin(), list.end());
+        QString result = QString::number(list.size()) + QChar(':');
+
+        for (const auto& item : list)
+        {
+            result += Field(item);
+        }
+
+        return result;
+    }
+}
+
+const qss::PropertyBlock& qss::StyleCache::computeStyle(const Element& element)
+{
+    auto& entry = m_entries[signature(element)];
+
+    if (entry.generation != 0 && isValid(entry))
+    {
+        m_hits++;
+        return entry.style;
+    }
+
+    m_misses++;
+
+    // Fragments were added, removed or toggled since the rules were indexed
+    if (!m_matcher || m_matcherGeneration != m_document.generation())
+    {
+        m_matcher.reset(new Matcher{ m_document });
+        m_matcherGeneration = m_document.generation();
+    }
+
+    std::vector<std::size_t> fragments;
+    entry.style = m_matcher->computeStyle(element, &fragments);
+    entry.generation = m_document.generation();
+    entry.blocks.clear();
+
+    for (auto index : fragments)
+    {
+        entry.blocks.emplace_back(index, m_document[static_cast<int>(index)].block().generation());
+    }
+
+    return entry.style;
+}
+
+void qss::StyleCache::clear()
+{
+    m_entries.clear();
+    m_matcher.reset();
+    m_hits = m_misses = 0;
+}
+
+QString qss::StyleCache::signature(const Element& element)
+{
+    QStringList params;
+
+    for (const auto& pair : element.params)
+    {
+        params.push_back(Field(pair.first) + Field(pair.second));
+    }
+
+    QString result = Field(element.type);
+    result += SortedJoin(element.inherits);
+    result += Field(element.id);
+    result += SortedJoin(element.classes);
+    result += SortedJoin(params);
+    result += SortedJoin(element.states);
+    result += Field(element.subControl);
+
+    // Ancestors and siblings take part in matching, so they are part of the
+    // key, each as one field so a sibling of the parent stays distinct from
+    // a sibling of the element itself
+    result += element.parent != nullptr ? Field(signature(*element.parent)) : QString{ "-" };
+    result += element.previousSibling != nullptr ? Field(signature(*element.previousSibling)) : QString{ "-" };
+
+    return result;
+}
+
+bool qss::StyleCache::isValid(const Entry& entry) const
+{
+    if (entry.generation != m_document.generation())
+    {
+        return false;
+    }
+
+    for (const auto& block : entry.blocks)
+    {
+        if (m_document[static_cast<int>(block.first)].block().generation() != block.second)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
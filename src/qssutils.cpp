@@ -1,5 +1,13 @@
 #include "../include/qssutils.h"
 
+#include <atomic>
+
+quint64 qss::nextGeneration() noexcept
+{
+    static std::atomic<quint64> generation{ 0 };
+    return ++generation;
+}
+
 std::ostream & qss::operator<<(std::ostream & stream, const QString& str)
 {
     stream << str.toStdString();
@@ -0,0 +1,425 @@
+#include "../include/qssvalue.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    typedef qss::PropertyValue::Color Color;
+
+    // Splits on whitespace and commas outside brackets and quotes; with
+    // arguments set only commas separate, as inside a function call
+    QStringList Tokenize(const QString& text, bool arguments = false)
+    {
+        QStringList tokens;
+        QString token;
+        int depth = 0;
+        QChar quote;
+
+        for (const auto c : text)
+        {
+            if (!quote.isNull())
+            {
+                if (c == quote) quote = QChar{};
+            }
+            else if (c == '"' || c == '\'')
+            {
+                quote = c;
+            }
+            else if (c == '(')
+            {
+                ++depth;
+            }
+            else if (c == ')')
+            {
+                depth = std::max(0, depth - 1);
+            }
+            else if (depth == 0 && (c == ',' || (!arguments && c.isSpace())))
+            {
+                if (!token.trimmed().isEmpty()) tokens.push_back(token.trimmed());
+                token.clear();
+                continue;
+            }
+
+            token += c;
+        }
+
+        if (!token.trimmed().isEmpty()) tokens.push_back(token.trimmed());
+        return tokens;
+    }
+
+    // Splits "name(args)" into its lower case name and argument list
+    bool SplitFunction(const QString& token, QString& name, QStringList& arguments)
+    {
+        const auto open = token.indexOf(QChar('('));
+
+        if (open <= 0 || !token.endsWith(QChar(')')))
+        {
+            return false;
+        }
+
+        name = token.left(open).trimmed().toLower();
+        arguments = Tokenize(token.mid(open + 1, token.size() - open - 2), true);
+        return true;
+    }
+
+    quint8 Channel(double value)
+    {
+        return static_cast<quint8>(std::lround(std::clamp(value, 0.0, 255.0)));
+    }
+
+    // A color component, either absolute in [0, range] or a percentage of range
+    bool Component(const QString& argument, double range, double& value)
+    {
+        bool ok = false;
+
+        if (argument.endsWith(QChar('%')))
+        {
+            value = argument.chopped(1).trimmed().toDouble(&ok) * range / 100.0;
+        }
+        else
+        {
+            value = argument.toDouble(&ok);
+        }
+
+        return ok;
+    }
+
+    bool Alpha(const QString& argument, quint8& alpha)
+    {
+        double value = 0;
+
+        if (!Component(argument, 255, value))
+        {
+            return false;
+        }
+
+        // rgba(0, 0, 0, 0.5) is a fraction, rgba(0, 0, 0, 128) is absolute
+        if (!argument.endsWith(QChar('%')) && argument.contains(QChar('.')) && value <= 1.0)
+        {
+            value *= 255;
+        }
+
+        alpha = Channel(value);
+        return true;
+    }
+
+    Color FromHue(double hue, double chroma, double offset)
+    {
+        // hue in degrees, chroma and offset as fractions of full intensity
+        const auto sector = std::fmod(std::max(hue, 0.0), 360.0) / 60.0;
+        const auto x = chroma * (1 - std::fabs(std::fmod(sector, 2.0) - 1));
+        double r = 0, g = 0, b = 0;
+
+        switch (static_cast<int>(sector))
+        {
+        case 0: r = chroma; g = x; break;
+        case 1: r = x; g = chroma; break;
+        case 2: g = chroma; b = x; break;
+        case 3: g = x; b = chroma; break;
+        case 4: r = x; b = chroma; break;
+        default: r = chroma; b = x; break;
+        }
+
+        Color color;
+        color.red = Channel((r + offset) * 255);
+        color.green = Channel((g + offset) * 255);
+        color.blue = Channel((b + offset) * 255);
+        return color;
+    }
+
+    std::optional<Color> NamedColor(const QString& name)
+    {
+        static const std::unordered_map<QString, Color, qss::QStringHasher> Named{
+            { "transparent", { 0, 0, 0, 0 } },
+            { "black", { 0, 0, 0, 255 } }, { "white", { 255, 255, 255, 255 } },
+            { "red", { 255, 0, 0, 255 } }, { "green", { 0, 128, 0, 255 } },
+            { "blue", { 0, 0, 255, 255 } }, { "yellow", { 255, 255, 0, 255 } },
+            { "cyan", { 0, 255, 255, 255 } }, { "aqua", { 0, 255, 255, 255 } },
+            { "magenta", { 255, 0, 255, 255 } }, { "fuchsia", { 255, 0, 255, 255 } },
+            { "gray", { 128, 128, 128, 255 } }, { "grey", { 128, 128, 128, 255 } },
+            { "silver", { 192, 192, 192, 255 } }, { "maroon", { 128, 0, 0, 255 } },
+            { "olive", { 128, 128, 0, 255 } }, { "lime", { 0, 255, 0, 255 } },
+            { "teal", { 0, 128, 128, 255 } }, { "navy", { 0, 0, 128, 255 } },
+            { "purple", { 128, 0, 128, 255 } }, { "orange", { 255, 165, 0, 255 } }
+        };
+
+        auto itr = Named.find(name);
+        return itr != Named.cend() ? std::optional<Color>{ itr->second } : std::nullopt;
+    }
+
+    std::optional<Color> HexColor(const QString& digits)
+    {
+        bool ok = false;
+        Color color;
+
+        if (digits.size() == 3)
+        {
+            color.red = static_cast<quint8>(digits.mid(0, 1).toInt(&ok, 16) * 17);
+            color.green = ok ? static_cast<quint8>(digits.mid(1, 1).toInt(&ok, 16) * 17) : 0;
+            color.blue = ok ? static_cast<quint8>(digits.mid(2, 1).toInt(&ok, 16) * 17) : 0;
+        }
+        else if (digits.size() == 6 || digits.size() == 8)
+        {
+            // Qt reads eight digits as #AARRGGBB
+            qsizetype offset = 0;
+
+            if (digits.size() == 8)
+            {
+                color.alpha = static_cast<quint8>(digits.mid(0, 2).toInt(&ok, 16));
+                offset = 2;
+
+                if (!ok) return std::nullopt;
+            }
+
+            color.red = static_cast<quint8>(digits.mid(offset, 2).toInt(&ok, 16));
+            color.green = ok ? static_cast<quint8>(digits.mid(offset + 2, 2).toInt(&ok, 16)) : 0;
+            color.blue = ok ? static_cast<quint8>(digits.mid(offset + 4, 2).toInt(&ok, 16)) : 0;
+        }
+
+        return ok ? std::optional<Color>{ color } : std::nullopt;
+    }
+}
+
+qss::PropertyValue& qss::PropertyValue::operator=(const QString& raw)
+{
+    m_raw = raw;
+    m_parsed.reset();
+    return *this;
+}
+
+const qss::PropertyValue::Color* qss::PropertyValue::color() const
+{
+    const auto& value = parsed();
+    return value.type == COLOR ? &value.color : nullptr;
+}
+
+const qss::PropertyValue::Length* qss::PropertyValue::length() const
+{
+    const auto& value = parsed();
+    return value.type == LENGTH ? &value.lengths.front() : nullptr;
+}
+
+const QString* qss::PropertyValue::url() const
+{
+    const auto& value = parsed();
+    return value.type == URL ? &value.url : nullptr;
+}
+
+const qss::PropertyValue::Gradient* qss::PropertyValue::gradient() const
+{
+    const auto& value = parsed();
+    return value.type == GRADIENT ? &value.gradient : nullptr;
+}
+
+double qss::PropertyValue::Gradient::coordinate(const QString& name, double fallback) const
+{
+    for (const auto& pair : coordinates)
+    {
+        if (pair.first == name)
+        {
+            return pair.second;
+        }
+    }
+
+    return fallback;
+}
+
+std::optional<qss::PropertyValue::Color> qss::PropertyValue::parseColor(const QString& token)
+{
+    const auto text = token.trimmed();
+
+    if (text.startsWith(QChar('#')))
+    {
+        return HexColor(text.mid(1));
+    }
+
+    QString name;
+    QStringList arguments;
+
+    if (!SplitFunction(text, name, arguments))
+    {
+        return NamedColor(text.toLower());
+    }
+
+    const bool alpha = name.endsWith(QChar('a'));
+
+    if (arguments.size() != (alpha ? 4 : 3))
+    {
+        return std::nullopt;
+    }
+
+    double first = 0, second = 0, third = 0;
+    Color color;
+
+    if (name == "rgb" || name == "rgba")
+    {
+        if (!Component(arguments[0], 255, first) || !Component(arguments[1], 255, second) || !Component(arguments[2], 255, third))
+        {
+            return std::nullopt;
+        }
+
+        color.red = Channel(first);
+        color.green = Channel(second);
+        color.blue = Channel(third);
+    }
+    else if (name == "hsv" || name == "hsva" || name == "hsl" || name == "hsla")
+    {
+        // Qt takes hue in degrees and the other two in [0, 255]
+        if (!Component(arguments[0], 359, first) || !Component(arguments[1], 255, second) || !Component(arguments[2], 255, third))
+        {
+            return std::nullopt;
+        }
+
+        const auto saturation = std::clamp(second / 255.0, 0.0, 1.0);
+        const auto level = std::clamp(third / 255.0, 0.0, 1.0);
+
+        if (name.startsWith(QString{ "hsv" }))
+        {
+            const auto chroma = level * saturation;
+            color = FromHue(first, chroma, level - chroma);
+        }
+        else
+        {
+            const auto chroma = (1 - std::fabs(2 * level - 1)) * saturation;
+            color = FromHue(first, chroma, level - chroma / 2);
+        }
+    }
+    else
+    {
+        return std::nullopt;
+    }
+
+    if (alpha && !Alpha(arguments[3], color.alpha))
+    {
+        return std::nullopt;
+    }
+
+    return color;
+}
+
+std::optional<qss::PropertyValue::Length> qss::PropertyValue::parseLength(const QString& token)
+{
+    static const std::pair<const char*, Length::Unit> Units[]{
+        { "px", Length::PX }, { "pt", Length::PT }, { "em", Length::EM }, { "ex", Length::EX }
+    };
+
+    const auto text = token.trimmed().toLower();
+    Length length;
+    auto number = text;
+
+    for (const auto& unit : Units)
+    {
+        if (text.endsWith(QString{ unit.first }))
+        {
+            number = text.chopped(2);
+            length.unit = unit.second;
+            break;
+        }
+    }
+
+    bool ok = false;
+    length.value = number.toDouble(&ok);
+    return ok ? std::optional<Length>{ length } : std::nullopt;
+}
+
+const qss::PropertyValue::Parsed& qss::PropertyValue::parsed() const
+{
+    if (m_parsed)
+    {
+        return *m_parsed;
+    }
+
+    auto value = std::make_shared<Parsed>();
+    value->keywords = Tokenize(m_raw);
+
+    QString name;
+    QStringList arguments;
+
+    if (value->keywords.size() == 1 && SplitFunction(value->keywords.front(), name, arguments))
+    {
+        if (name == "url" && arguments.size() == 1)
+        {
+            auto path = arguments.front();
+
+            if (path.size() >= 2 && (path.startsWith(QChar('"')) || path.startsWith(QChar('\''))) && path.endsWith(path.at(0)))
+            {
+                path = path.mid(1, path.size() - 2);
+            }
+
+            value->type = URL;
+            value->url = path;
+        }
+        else if (name == "qlineargradient" || name == "qradialgradient" || name == "qconicalgradient")
+        {
+            auto& gradient = value->gradient;
+            gradient.kind = name == "qlineargradient" ? Gradient::LINEAR : name == "qradialgradient" ? Gradient::RADIAL : Gradient::CONICAL;
+            value->type = GRADIENT;
+
+            // Arguments are "key: number", "spread: mode" or "stop: position color"
+            for (const auto& argument : arguments)
+            {
+                const auto colon = argument.indexOf(QChar(':'));
+                const auto key = argument.left(colon).trimmed().toLower();
+                const auto rest = argument.mid(colon + 1).trimmed();
+                bool ok = colon > 0;
+
+                if (ok && key == "stop")
+                {
+                    auto parts = Tokenize(rest);
+                    Gradient::Stop stop;
+                    stop.position = parts.isEmpty() ? 0 : parts.front().toDouble(&ok);
+                    auto color = parts.size() == 2 ? parseColor(parts[1]) : std::nullopt;
+                    ok = ok && color.has_value();
+                    stop.color = color.value_or(Color{});
+                    gradient.stops.push_back(stop);
+                }
+                else if (ok && key == "spread")
+                {
+                    gradient.spread = rest;
+                }
+                else if (ok)
+                {
+                    gradient.coordinates.emplace_back(key, rest.toDouble(&ok));
+                }
+
+                if (!ok)
+                {
+                    value->type = KEYWORDS;
+                    value->gradient = Gradient{};
+                    break;
+                }
+            }
+        }
+    }
+
+    if (value->type == KEYWORDS && value->keywords.size() == 1)
+    {
+        if (auto color = parseColor(value->keywords.front()))
+        {
+            value->type = COLOR;
+            value->color = *color;
+        }
+    }
+
+    if (value->type == KEYWORDS && !value->keywords.isEmpty())
+    {
+        for (const auto& keyword : value->keywords)
+        {
+            auto length = parseLength(keyword);
+
+            if (!length)
+            {
+                value->lengths.clear();
+                break;
+            }
+
+            value->lengths.push_back(*length);
+        }
+
+        value->type = value->lengths.empty() ? KEYWORDS : LENGTH;
+    }
+
+    m_parsed = value;
+    return *m_parsed;
+}
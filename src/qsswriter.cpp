@@ -0,0 +1,274 @@
+#include "../include/qsswriter.h"
+#include "../include/qssinstrument.h"
+
+qss::Writer::Writer(Mode mode)
+    : m_mode{ mode }
+{
+    for (const auto& pair : Delimiters)
+    {
+        m_delimiters[pair.first] = pair.second;
+    }
+}
+
+qss::Writer::Writer(QString& output, Mode mode)
+    : Writer{ mode }
+{
+    m_output = &output;
+}
+
+qss::Writer::Writer(QTextStream& stream, Mode mode)
+    : Writer{ mode }
+{
+    m_stream = &stream;
+    m_chunk.reserve(ChunkSize);
+}
+
+qss::Writer::Writer(QIODevice& device, Mode mode)
+    : Writer{ mode }
+{
+    m_device = &device;
+    m_chunk.reserve(ChunkSize);
+}
+
+qss::Writer::~Writer()
+{
+    flush();
+}
+
+qss::Writer& qss::Writer::write(const Document& document)
+{
+    QSS_SCOPE(SERIALIZE);
+    for (const auto& pair : document)
+    {
+        if (pair.second)
+        {
+            write(pair.first);
+
+            if (m_mode == PRETTY)
+            {
+                put(QChar('\n'));
+            }
+        }
+    }
+
+    return *this;
+}
+
+qss::Writer& qss::Writer::write(const Snapshot& snapshot)
+{
+    QSS_SCOPE(SERIALIZE);
+    for (const auto& entry : snapshot)
+    {
+        if (entry.enabled)
+        {
+            write(*entry.fragment);
+
+            if (m_mode == PRETTY)
+            {
+                put(QChar('\n'));
+            }
+        }
+    }
+
+    return *this;
+}
+
+qss::Writer& qss::Writer::write(const Fragment& fragment)
+{
+    QSS_SCOPE(SERIALIZE);
+    write(fragment.selector());
+
+    if (m_mode == PRETTY)
+    {
+        put(QChar(' '));
+        put(QSS_BLOCK_START_DELIMITER);
+        put(QChar('\n'));
+        write(fragment.block());
+        put(QSS_BLOCK_END_DELIMITER);
+        put(QChar('\n'));
+    }
+    else
+    {
+        put(QSS_BLOCK_START_DELIMITER);
+        write(fragment.block());
+        put(QSS_BLOCK_END_DELIMITER);
+    }
+
+    return *this;
+}
+
+qss::Writer& qss::Writer::write(const Selector& selector)
+{
+    QSS_SCOPE(SERIALIZE);
+    for (auto itr = selector.cbegin(); itr != selector.cend(); ++itr)
+    {
+        // Minified, only a descendant needs a separator, since the other
+        // combinators delimit the elements themselves
+        const auto position = itr->position();
+
+        if (itr != selector.cbegin() && (m_mode == PRETTY || position == SelectorElement::DESCENDANT || position == SelectorElement::PARENT))
+        {
+            put(QChar(' '));
+        }
+
+        write(*itr);
+    }
+
+    return *this;
+}
+
+qss::Writer& qss::Writer::write(const SelectorElement& element)
+{
+    QSS_SCOPE(SERIALIZE);
+    if (element.m_position != SelectorElement::PARENT && element.m_position != SelectorElement::DESCENDANT)
+    {
+        put(SelectorElement::Combinators.at(element.m_position));
+
+        if (m_mode == PRETTY)
+        {
+            put(QChar(' '));
+        }
+    }
+    else if (element.m_position == SelectorElement::DESCENDANT && m_mode == PRETTY)
+    {
+        put(QChar(' '));
+    }
+
+    put(element.m_name.toString());
+
+    if (!element.m_id.isEmpty())
+    {
+        put(QSS_ID_DELIMITER);
+        put(element.m_id.toString());
+    }
+
+    for (const auto& cl : element.m_classes)
+    {
+        put(QSS_CLASS_DELIMITER);
+        put(cl.toString());
+    }
+
+    for (const auto& pair : element.m_params)
+    {
+        put(QSS_SELECT_PARAM_START_DELIMITER);
+        put(pair.first.toString());
+        put(QSS_PARAM_DELIMITER);
+        put(QChar('"'));
+        put(pair.second);
+        put(QChar('"'));
+        put(QSS_SELECT_PARAM_END_DELIMITER);
+    }
+
+    if (!element.m_subControl.isEmpty())
+    {
+        put(QSS_SUB_CONTROL_DELIMITER);
+        put(element.m_subControl.toString());
+    }
+
+    if (!element.m_psuedoClass.isEmpty())
+    {
+        put(QSS_PSEUDO_CLASS_DELIMITER);
+        put(element.m_psuedoClass);
+    }
+
+    return *this;
+}
+
+qss::Writer& qss::Writer::write(const PropertyBlock& block)
+{
+    QSS_SCOPE(SERIALIZE);
+    auto first = true;
+
+    for (auto itr = block.cbegin(); itr != block.cend(); ++itr)
+    {
+        if (!itr->second.second)
+        {
+            continue;
+        }
+
+        if (m_mode == PRETTY)
+        {
+            put(QChar('\t'));
+            put(itr->first.toString());
+            put(QSS_PSEUDO_CLASS_DELIMITER);
+            put(QChar(' '));
+            put(itr->second.first.toString());
+            put(QSS_STATEMENT_END_DELIMITER);
+            put(QChar('\n'));
+        }
+        else
+        {
+            // The last declaration of a block needs no terminator
+            if (!first)
+            {
+                put(QSS_STATEMENT_END_DELIMITER);
+            }
+
+            put(itr->first.toString());
+            put(QSS_PSEUDO_CLASS_DELIMITER);
+            put(itr->second.first.toString());
+        }
+
+        first = false;
+    }
+
+    return *this;
+}
+
+void qss::Writer::flush()
+{
+    if (m_chunk.isEmpty())
+    {
+        return;
+    }
+
+    if (m_stream != nullptr)
+    {
+        *m_stream << m_chunk;
+    }
+    else if (m_device != nullptr)
+    {
+        m_device->write(m_chunk.toUtf8());
+    }
+
+    // Keeps the capacity, so the chunk is allocated once per writer
+    m_chunk.truncate(0);
+}
+
+void qss::Writer::put(QStringView text)
+{
+    m_size += text.size();
+
+    if (m_output != nullptr)
+    {
+        m_output->append(text);
+    }
+    else if (m_stream != nullptr || m_device != nullptr)
+    {
+        if (m_chunk.size() + text.size() > ChunkSize)
+        {
+            flush();
+        }
+
+        m_chunk.append(text);
+    }
+}
+
+void qss::Writer::put(QChar c)
+{
+    m_size += 1;
+
+    if (m_output != nullptr)
+    {
+        m_output->append(c);
+    }
+    else if (m_stream != nullptr || m_device != nullptr)
+    {
+        if (m_chunk.size() == ChunkSize)
+        {
+            flush();
+        }
+
+        m_chunk.append(c);
+    }
+}
@@ -1,9 +1,25 @@
 #include <QCoreApplication>
+#include <QDir>
+#include <QFile>
 #include <QString>
 
-#include "qssdocument.h"
+#include <atomic>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
 
+#include "qsscompileddocument.h"
+#include "qssdocumentview.h"
+#include "qssinstrument.h"
+#include "qssmatcher.h"
+#include "qsssnapshot.h"
+#include "qssstaticdocument.h"
+#include "qssstreamparser.h"
+#include "qssstylecache.h"
+#include "qsswriter.h"
 
+
+#define LOG(X)  { std::cout << X << std::endl; }
 #define RESULTV(A, B, V) LOG(A << " should be: " << #V << " | Test pass status: " << (B == V));
 #define RESULTSTR(A, B, V) LOG(A << " should be: " << V << " | Test pass status: " << (B == V));
  
@@ -73,6 +89,1065 @@ void TestQSSParse()
     LOG("Passed: " << (QString::compare(fragment.toString(), manual.toString()) == 0));
 }
 
+void TestQSSLexer()
+{
+    LOG("\n\nLexing comments, quotes and escapes...");
+    QString test = "/* header { comment } */ QLabel { color: red; /* a; b: c */ }\n"
+        "QPushButton[text=\"a } b\"] { image: url(:/icons/a.png); font-family: \"x; y\"; }";
+    qss::Document qss{ test };
+
+    RESULTV("Total Fragments", qss.totalFragments(), 2);
+    RESULTV("Property count for 1st block", qss[0].block().size(), 1);
+    RESULTSTR("Selector param", qss[1].selector().front().value("text"), "a } b");
+    RESULTV("Property count for 2nd block", qss[1].block().size(), 2);
+
+    qss::Lexer lexer;
+    lexer.feed(test);
+    lexer.finish();
+    const auto& token = lexer.tokens().back();
+    RESULTSTR("Value containing ':'", lexer.text(lexer.declaration(token, 0).value).toString(), "url(:/icons/a.png)");
+    RESULTSTR("Quoted value containing ';'", lexer.text(lexer.declaration(token, 1).value).toString(), "\"x; y\"");
+
+    // QSS has no line comments, so slashes in an unquoted url stay
+    const qss::Document urls{ "QLabel { image: url(file:///a.png); } QPushButton { image: url(http://b/c.png); }" };
+    RESULTV("Fragments after '//'", urls.totalFragments(), 2);
+    RESULTSTR("Value containing '//'", urls[1].block().value("image"), "url(http://b/c.png)");
+}
+
+void TestQSSDocumentView()
+{
+    LOG("\n\nReading QSS through a view...");
+    QString test = "QLabel { color: red; border: 1px solid black; color: blue; } QLabel#title { font: bold; }";
+    qss::DocumentView view{ test };
+
+    RESULTV("Total Fragments", view.totalFragments(), 2);
+    RESULTV("Total properties", view.totalProperties(), 4);
+    RESULTSTR("Selector of 2nd fragment", view[1].selector().toString(), "QLabel#title");
+    RESULTSTR("Overridden value", view[0].value(u"color").toString(), "blue");
+
+    auto document = view.toDocument();
+    RESULTV("Document fragments", document.totalFragments(), 2);
+    RESULTV("Property count for 1st block", document[0].block().size(), 2);
+}
+
+void TestQSSStreamParser()
+{
+    LOG("\n\nStreaming QSS one byte at a time...");
+    QByteArray test = "QLabel { color: red; /* } */ } QLabel[text=\"\xc3\xa9 }\"] { font: \"a;b\"; }";
+    qss::Document streamed;
+    qss::StreamParser parser{ [&streamed](const qss::Fragment& fragment) { streamed.addFragment(fragment); } };
+
+    for (auto i = 0; i < test.size(); ++i)
+    {
+        parser.feed(QByteArrayView{ test.constData() + i, 1 });
+    }
+    parser.finish();
+
+    qss::Document parsed{ QString::fromUtf8(test) };
+    RESULTV("Streamed fragments", parser.totalFragments(), 2);
+    auto same = streamed.toString() == parsed.toString();
+    RESULTV("Matches whole parse", same, true);
+}
+
+void TestQSSParallelParse()
+{
+    LOG("\n\nParsing QSS on a thread pool...");
+    QString test;
+
+    for (auto i = 0; i < 200; ++i)
+    {
+        test += QString{ "QLabel#label%1 { color: red; margin: %1px; }\n" }.arg(i);
+    }
+
+    qss::Document serial{ test };
+    qss::Document parallel;
+    parallel.parse(test, QThreadPool::globalInstance());
+
+    RESULTV("Total Fragments", parallel.totalFragments(), 200);
+    auto same = serial.toString() == parallel.toString();
+    RESULTV("Matches serial parse", same, true);
+
+    // The only thread of the pool parses, so no queued run can start
+    QThreadPool single;
+    single.setMaxThreadCount(1);
+    qss::Document nested;
+    single.start([&nested, &test, &single]() { nested.parse(test, &single); });
+    single.waitForDone();
+    RESULTV("Parsing from a busy pool", (nested.toString() == serial.toString()), true);
+}
+
+void TestQSSUtf8()
+{
+    LOG("\n\nLoading UTF-8 QSS from memory and from a mapped file...");
+    QByteArray test = "/* \xc3\xa9 */ QLabel[text=\"\xc3\xa9\"] { color: red; }\nQLabel /* trailing */\n{ font: bold; }";
+    auto parsed = qss::Document{ QString::fromUtf8(test) }.toString();
+
+    auto fromUtf8 = qss::Document::fromUtf8(test);
+    RESULTV("Total Fragments", fromUtf8.totalFragments(), 2);
+    RESULTV("Decoded selector param", fromUtf8[0].selector().front().value("text"), QString::fromUtf8("\xc3\xa9"));
+    auto same = fromUtf8.toString() == parsed;
+    RESULTV("Matches UTF-16 parse", same, true);
+
+    QString path = QDir::tempPath() + "/test_qss_utf8.qss";
+    QFile file{ path };
+    file.open(QIODevice::WriteOnly);
+    file.write(test);
+    file.close();
+
+    same = qss::Document::fromFile(path).toString() == parsed;
+    RESULTV("Mapped file matches UTF-16 parse", same, true);
+    QFile::remove(path);
+}
+
+void TestQSSMatcher()
+{
+    LOG("\n\nMatching fragments against elements...");
+    QString test = "QWidget { color: red; }"
+        "QPushButton, QToolButton { color: blue; }"
+        "QDialog > QPushButton#ok:hover { color: green; }"
+        "QDialog QLabel + QPushButton[flat=\"true\"] { color: white; }"
+        "QLabel ~ .QPushButton::menu-indicator { image: none; }";
+    qss::Document qss{ test };
+    qss::Matcher matcher{ qss };
+
+    qss::Element dialog;
+    dialog.type = "QDialog";
+    dialog.inherits = QStringList{ "QWidget" };
+
+    qss::Element label;
+    label.type = "QLabel";
+    label.parent = &dialog;
+
+    qss::Element button;
+    button.type = "QPushButton";
+    button.inherits = QStringList{ "QAbstractButton", "QWidget" };
+    button.id = "ok";
+    button.parent = &dialog;
+    button.previousSibling = &label;
+
+    RESULTV("Plain button matches", matcher.match(button).size(), 2);
+
+    const auto atoms = qss::Atom::count();
+    qss::Element generated = button;
+    generated.id = "generatedName4711";
+    generated.classes.push_back("generatedClass4711");
+    generated.params["generatedKey4711"] = "1";
+    RESULTV("Unknown names match as absent", matcher.match(generated).size(), 2);
+    RESULTV("Matching interns nothing", qss::Atom::count(), atoms);
+
+    // Names are looked up when rules are tested, not when the element is built
+    qss.addFragment("#generatedName4711.generatedClass4711 { color: black; }");
+    RESULTV("Later fragment matches an earlier element", qss::Matcher{ qss }.match(generated).size(), 3);
+    qss.removeFragment(static_cast<int>(qss.totalFragments()) - 1);
+
+    button.states.push_back("hover");
+    button.params["flat"] = "true";
+    auto matches = matcher.match(button);
+    RESULTV("Hovered flat button matches", matches.size(), 4);
+    RESULTV("Child rule matched", matches[2], 2);
+
+    qss::Element indicator = button;
+    indicator.subControl = "menu-indicator";
+    RESULTV("Sub-control matches", matcher.match(indicator).size(), 1);
+    indicator.subControl = "generatedControl4711";
+    RESULTV("Unknown sub-control matches nothing", matcher.match(indicator).size(), 0);
+
+    qss.toggleFragment(0);
+    RESULTV("Disabled fragment skipped", matcher.match(dialog).size(), 0);
+}
+
+void TestQSSCascade()
+{
+    LOG("\n\nResolving the cascade...");
+    QString test = "#ok { margin: 1px; }"
+        "QPushButton:hover { color: blue; border: none; }"
+        "QWidget { color: red; margin: 2px; padding: 3px; }"
+        "QPushButton { color: green; }";
+    qss::Document qss{ test };
+    qss.begin()->first.enableParam("margin", false);
+    qss::Matcher matcher{ qss };
+
+    qss::Element button;
+    button.type = "QPushButton";
+    button.inherits = QStringList{ "QWidget" };
+    button.id = "ok";
+    button.states.push_back("hover");
+
+    auto style = matcher.computeStyle(button);
+    RESULTV("Specificity of #ok", qss[0].selector().specificity().ids, 1);
+    RESULTV("Specificity of QPushButton:hover", qss[1].selector().specificity().classes, 1);
+    RESULTV("Resolved property count", style.size(), 4);
+    RESULTSTR("More specific rule wins", style.value("color"), "blue");
+    RESULTSTR("Disabled property skipped", style.value("margin"), "2px");
+}
+
+void TestQSSStyleCache()
+{
+    LOG("\n\nCaching computed styles...");
+    qss::Document qss{ "QLabel { color: red; } QPushButton { color: blue; }" };
+    qss::StyleCache cache{ qss };
+
+    qss::Element label;
+    label.type = "QLabel";
+    qss::Element button;
+    button.type = "QPushButton";
+
+    cache.computeStyle(label);
+    cache.computeStyle(button);
+    cache.computeStyle(label);
+    RESULTV("Hits after repeated lookup", cache.hits(), 1);
+    RESULTV("Misses after first lookups", cache.misses(), 2);
+
+    qss.front().addParam("margin", "1px");
+    RESULTV("Edited block refreshes its entry", cache.computeStyle(label).size(), 2);
+    cache.computeStyle(button);
+    RESULTV("Unrelated entry still cached", cache.hits(), 2);
+
+    qss.toggleFragment(1);
+    RESULTV("Disabled fragment refreshes entries", cache.computeStyle(button).size(), 0);
+    RESULTV("Total misses", cache.misses(), 4);
+
+    // Moving the fragments out changes the generation the cache bound to
+    cache.computeStyle(label);
+    auto taken = std::move(qss);
+    RESULTV("Moved from document refreshes entries", cache.computeStyle(label).size(), 0);
+    RESULTV("Moved to document keeps the fragments", taken.totalFragments(), 2);
+
+    qss = std::move(taken);
+    cache.computeStyle(label);
+    taken = std::move(qss);
+    RESULTV("Move assigned from document refreshes entries", cache.computeStyle(label).size(), 0);
+
+    qss = std::move(taken);
+    cache.computeStyle(label);
+    taken += std::move(qss);
+    RESULTV("Appended from document refreshes entries", cache.computeStyle(label).size(), 0);
+
+    // Values may contain any separator without running into the next field
+    qss::Element joined = label;
+    joined.params["a"] = "x,b=y";
+    qss::Element split = label;
+    split.params["a"] = "x";
+    split.params["b"] = "y";
+    RESULTV("Separators in values keep keys apart", (qss::StyleCache::signature(joined) == qss::StyleCache::signature(split)), false);
+
+    qss::Element sibling = button;
+    qss::Element parent = label;
+    parent.previousSibling = &sibling;
+    qss::Element parentSibling = button;
+    parentSibling.parent = &parent;
+    qss::Element ownSibling = button;
+    ownSibling.parent = &label;
+    ownSibling.previousSibling = &sibling;
+    RESULTV("Sibling of the parent differs from own sibling", (qss::StyleCache::signature(parentSibling) == qss::StyleCache::signature(ownSibling)), false);
+}
+
+void TestQSSAtom()
+{
+    LOG("\n\nInterning names...");
+    qss::Document qss{ "QLabel { background-color: red; } QPushButton { background-color: blue; }" };
+    const auto count = qss::Atom::count();
+
+    qss::Atom atom{ QString{ "background-color" } };
+    auto first = qss[0].block().cbegin()->first;
+    auto second = qss[1].block().cbegin()->first;
+    RESULTV("Blocks share one property name", (first == second), true);
+    RESULTV("Atom of equal text is the same", (atom == first), true);
+    RESULTV("Existing name is not added again", qss::Atom::count(), count);
+    RESULTV("Unknown name is not found", qss::Atom::find("never-interned-name").has_value(), false);
+    RESULTSTR("Lookup by text", qss[0].block().value("background-color"), "red");
+    RESULTSTR("Selector name is an atom", qss[1].selector()[0].name(), "QPushButton");
+}
+
+void TestQSSKnownProperties()
+{
+    LOG("\n\nResolving known properties...");
+    qss::PropertyBlock block{ "colour: red; qproperty-flat: true; color: blue; border-image: none;" };
+
+    RESULTV("Known name resolves at compile time", (qss::propertyFromName(std::string_view{ "subcontrol-origin" }) == qss::QSS_PROPERTY_SUBCONTROL_ORIGIN), true);
+    RESULTV("Custom name is unknown", (qss::propertyFromName(std::string_view{ "qproperty-flat" }) == qss::QSS_PROPERTY_UNKNOWN), true);
+    RESULTSTR("Lookup by id", block.value(qss::QSS_PROPERTY_COLOR), "blue");
+    RESULTV("Unknown properties flagged", block.unknownParams().size(), 1);
+    RESULTSTR("Unknown property name", block.unknownParams().front(), "colour");
+
+    block.remove("colour");
+    RESULTSTR("Lookup after removal", block.value("border-image"), "none");
+    RESULTSTR("Insertion order kept", block.cbegin()->first, "qproperty-flat");
+}
+
+void TestQSSTypedValues()
+{
+    LOG("\n\nReading typed values...");
+    qss::PropertyBlock block{ "color: rgba(255, 0, 0, 50%); margin: 2px 4pt; image: url(\":/icons/close.png\");"
+        "background: qlineargradient(x1: 0, y1: 0, x2: 0, y2: 1, stop: 0 #fff, stop: 1 hsv(240, 255, 255));"
+        "border: 1px solid black; border-color: #80ff0000;" };
+
+    const auto* color = block.typedValue(qss::QSS_PROPERTY_COLOR);
+    RESULTV("Value parsed lazily", color->isParsed(), false);
+    RESULTV("Color alpha", color->color()->alpha, 128);
+    RESULTV("Value parsed once read", color->isParsed(), true);
+    RESULTV("Hex with alpha", block.typedValue("border-color")->color()->alpha, 128);
+    RESULTV("Length count", block.typedValue("margin")->lengths().size(), 2);
+    RESULTV("Length unit", (block.typedValue("margin")->lengths()[1].unit == qss::PropertyValue::Length::PT), true);
+    RESULTSTR("Url path", *block.typedValue("image")->url(), ":/icons/close.png");
+
+    const auto* gradient = block.typedValue("background")->gradient();
+    RESULTV("Gradient stops", gradient->stops.size(), 2);
+    RESULTV("Gradient coordinate", gradient->coordinate("y2"), 1);
+    RESULTV("Gradient stop color", gradient->stops[1].color.blue, 255);
+    RESULTV("Keyword list", block.typedValue("border")->keywords().size(), 3);
+    RESULTV("Mixed value is keywords", (block.typedValue("border")->type() == qss::PropertyValue::KEYWORDS), true);
+}
+
+void TestQSSPropertyOrder()
+{
+    LOG("\n\nKeeping properties in order...");
+    qss::PropertyBlock block;
+
+    for (int i = 0; i < 12; ++i)
+    {
+        block.addParam(QString{ "qproperty-p%1" }.arg(i), QString::number(i));
+    }
+
+    block.addParam("color", "red");
+    block.remove("qproperty-p0");
+    block.toggleParam("qproperty-p11");
+    RESULTSTR("Indexed lookup after removal", block.value("qproperty-p5"), "5");
+    RESULTSTR("Known property past the threshold", block.value(qss::QSS_PROPERTY_COLOR), "red");
+    RESULTSTR("First param after removal", block.cbegin()->first, "qproperty-p1");
+
+    qss::PropertyBlock small{ "margin: 1px; color: red; padding: 2px;" };
+    small.addParam("margin", "3px");
+    small.remove("color");
+    RESULTSTR("Serialized in insertion order", small.toString(), "\tmargin: 3px;\n\tpadding: 2px;\n");
+
+    qss::PropertyBlock copy = block;
+    copy.remove("qproperty-p5");
+    RESULTV("Copy keeps its own index", copy.size() + 1, block.size());
+    RESULTV("Disabled param not serialized", block.toString().contains("qproperty-p11"), false);
+}
+
+void TestQSSSelectorIndex()
+{
+    LOG("\n\nLooking up fragments by selector...");
+    qss::Document base{ "QLabel { color: red; } QPushButton:hover { color: blue; }" };
+    qss::Document theme{ "QPushButton:hover { border: none; } QLabel{color:green;} QToolTip { color: black; }" };
+
+    base += theme;
+    RESULTV("Merged fragment count", base.totalFragments(), 3);
+    RESULTV("Selector found despite spacing", base.find("QPushButton:hover").size(), 1);
+    RESULTSTR("Merged property", base.value("QPushButton:hover", "border"), "none");
+    RESULTSTR("Overridden property", base.value("QLabel", "color"), "green");
+
+    base.removeFragment(0);
+    RESULTV("Positions shift after removal", base.find("QToolTip").front(), 1);
+
+    base.front().select("QDialog");
+    RESULTV("Edited selector is found", base.find("QDialog").size(), 1);
+    base.reindex();
+    RESULTV("Edited selector is re-indexed", base.find("QDialog").size(), 1);
+    RESULTV("Unknown selector", base.find("QLabel").size(), 0);
+
+    // Lookups only read, so threads may share a document
+    auto concurrent = [&base](const QString& selector) {
+        std::atomic<int> found{ 0 };
+        std::vector<std::thread> lookups;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            lookups.emplace_back([&base, &found, &selector]() {
+                for (int j = 0; j < 100; ++j)
+                {
+                    found += static_cast<int>(base.find(selector).size());
+                }
+            });
+        }
+
+        for (auto& lookup : lookups)
+        {
+            lookup.join();
+        }
+
+        return found.load();
+    };
+
+    RESULTV("Concurrent lookups", concurrent("QToolTip"), 400);
+
+    // Scanning after an edit through a mutable reference reads the hashes
+    // the edit computed and writes nothing
+    base.front().select("QFrame");
+    RESULTV("Concurrent lookups while scanning", concurrent("QFrame"), 400);
+}
+
+void TestQSSInheritable()
+{
+    LOG("\n\nCollecting inheritable fragments...");
+    // Single element selectors are matched by id and never read past their one element
+    const qss::Document qss{ "#ok { color: red; } QLabel#title { color: blue; } QDialog QPushButton#ok { margin: 1px; }" };
+
+    const auto inherited = qss.inheritable("QPushButton#ok");
+    RESULTV("Id and descendant rules inherited", inherited.totalFragments(), 2);
+    RESULTSTR("Single element rule kept", inherited.value("#ok", "color"), "red");
+    RESULTSTR("Descendant rule kept", inherited.value("QDialog QPushButton#ok", "margin"), "1px");
+
+    const qss::Document single{ "#a { color: red; } #b { color: blue; }" };
+    RESULTV("Only single element selectors", single.inheritable("QLabel#b").totalFragments(), 1);
+}
+
+void TestQSSStructuralEquality()
+{
+    LOG("\n\nComparing structurally...");
+    qss::Fragment lhs{ "QPushButton.a.b[flat=\"true\"] > QLabel { color: red; margin: 1px; }" };
+    qss::Fragment rhs{ "QPushButton.b.a[flat=\"true\"]>QLabel { margin: 1px; color: red; }" };
+
+    RESULTV("Class and param order ignored", (lhs == rhs), true);
+    RESULTV("Equal fragments hash equal", (lhs.hash() == rhs.hash()), true);
+
+    rhs.block().toggleParam("color");
+    RESULTV("Disabled param differs", (lhs.block() == rhs.block()), false);
+    rhs.block().toggleParam("color");
+    RESULTV("Hash follows edits", (lhs.block().hash() == rhs.block().hash()), true);
+
+    rhs.selector().back().sub("item");
+    RESULTV("Edited selector element differs", (lhs.selector() == rhs.selector()), false);
+
+    std::unordered_set<qss::Fragment, qss::Hasher> set{ lhs, rhs, lhs };
+    RESULTV("Usable as hash keys", set.size(), 2);
+
+    qss::SelectorElement copy;
+    copy = lhs.selector().front();
+    RESULTV("Copy keeps every field", (copy == lhs.selector().front()), true);
+}
+
+void TestQSSBulkRemoval()
+{
+    LOG("\n\nRemoving fragments in bulk...");
+    qss::Document qss{ "QPushButton.a.b { color: red; } QLabel { color: blue; } QPushButton.b.a { margin: 1px; } QSlider { color: green; }" };
+    qss.enableFragment(3, false);
+
+    qss.removeFragment("QLabel{color:blue;}");
+    RESULTV("Structurally equal fragment removed", qss.totalFragments(), 3);
+
+    qss.removeFragment("QPushButton.a.b { color: blue; }");
+    RESULTV("Different block kept", qss.totalFragments(), 3);
+
+    qss.removeFragments(QStringList{ "QPushButton.b.a", "QToolButton" });
+    RESULTV("Selectors matched in any class order", qss.totalFragments(), 1);
+    RESULTSTR("Survivor", qss.front().selector().toString(), "QSlider");
+    RESULTV("Survivor keeps its state", qss.isEnabled(0), false);
+
+    qss.addFragment("QLabel { color: blue; }");
+    qss.removeIf([](const qss::Document::QSSFragmentPair& pair) { return !pair.second; });
+    RESULTV("Disabled fragments removed", qss.totalFragments(), 1);
+    RESULTV("Index follows compaction", qss.find("QLabel").front(), 0);
+}
+
+void TestQSSIncrementalEdit()
+{
+    LOG("\n\nEditing the source incrementally...");
+    const QString source{ "QLabel { color: red; }\n/* buttons */\nQPushButton { margin: 1px; }\nQSlider { color: blue; }\n" };
+    qss::Document qss{ source };
+    qss.enableFragment(2, false);
+
+    auto position = source.indexOf("1px");
+    auto range = qss.edit(position, 3, "2px");
+    RESULTV("Only the edited fragment changes", range.first, 1);
+    RESULTV("One fragment removed", range.removed, 1);
+    RESULTV("One fragment inserted", range.inserted, 1);
+    RESULTSTR("New value parsed", qss[1].block().value("margin"), "2px");
+    RESULTV("Later fragments keep their state", qss.isEnabled(2), false);
+
+    qss.enableFragment(1, false);
+    range = qss.edit(qss.source().indexOf("2px"), 3, "4px");
+    RESULTV("Edited fragment replaced", range.inserted, 1);
+    RESULTV("Edited fragment keeps its state", qss.isEnabled(1), false);
+    RESULTV("Edited fragment is re-indexed", qss.find("QPushButton").front(), 1);
+    qss.enableFragment(1, true);
+
+    range = qss.edit(qss.source().indexOf("buttons"), 7, "push buttons");
+    RESULTV("Comment edits change nothing", range.removed + range.inserted, 0);
+
+    position = qss.source().indexOf("QSlider");
+    range = qss.edit(position, 0, "QToolButton { color: green; } ");
+    RESULTV("Insertion at a boundary", range.first, 2);
+    RESULTV("Inserted fragment added", range.inserted, 1);
+    RESULTV("Nothing removed", range.removed, 0);
+    RESULTV("Fragment count follows", qss.totalFragments(), 4);
+
+    position = qss.source().indexOf("QPushButton");
+    range = qss.edit(position, 0, "/*");
+    RESULTV("Opening a comment swallows fragments", qss.totalFragments(), 1);
+
+    range = qss.edit(position, 2, "");
+    RESULTV("Closing it restores them", qss.totalFragments(), 4);
+
+    const qss::Document reparsed{ qss.source() };
+    auto agree = reparsed.totalFragments() == qss.totalFragments();
+    for (std::size_t i = 0; agree && i < reparsed.totalFragments(); ++i)
+    {
+        agree = reparsed[i] == qss[i];
+    }
+    RESULTV("Source and document agree", agree, true);
+
+    const auto before = qss.source();
+    auto failed = false;
+    try
+    {
+        qss.edit(0, 0, "{");
+    }
+    catch (const qss::Exception&)
+    {
+        failed = true;
+    }
+    RESULTV("Invalid text throws", failed, true);
+    RESULTV("Failed edit leaves the document", qss.totalFragments(), 4);
+    RESULTV("Failed edit restores the source", (qss.source() == before), true);
+
+    qss.addFragment("QMenu { color: red; }");
+    RESULTV("Other changes drop the source", qss.isEditable(), false);
+}
+
+void TestQSSWriter()
+{
+    LOG("\n\nWriting minified and pretty output...");
+    const qss::Document qss{ "QFrame QLabel#title.big { color: red; margin: 1px 2px; }\n"
+        "QFrame > QPushButton[flat=\"true\"]::menu-indicator:hover { image: url(a.png); }\n" };
+
+    const auto minified = qss::Writer::toString(qss, qss::Writer::MINIFIED);
+    RESULTSTR("Minified", minified, "QFrame QLabel#title.big{color:red;margin:1px 2px}QFrame>QPushButton[flat=\"true\"]::menu-indicator:hover{image:url(a.png)}");
+    RESULTV("Minified round trips", (qss::Document{ minified }.toString() == qss.toString()), true);
+    RESULTV("Pretty matches toString", (qss::Writer::toString(qss) == qss.toString()), true);
+    RESULTV("Measure matches output", qss::Writer::measure(qss, qss::Writer::MINIFIED), minified.size());
+
+    QString streamed;
+    {
+        QTextStream stream{ &streamed };
+        qss::Writer writer{ stream, qss::Writer::MINIFIED };
+        writer.write(qss);
+    }
+    RESULTV("Stream receives the same text", (streamed == minified), true);
+}
+
+void TestQSSCompiledDocument()
+{
+    LOG("\n\nCompiling to the binary format...");
+    qss::Document qss{ "QFrame > QPushButton#ok.big.wide[flat=\"true\"]::menu-indicator:hover { color: red; margin: 1px; }\n"
+        "QLabel { color: blue; }\nQLabel { font: bold; }\n" };
+    qss.enableFragment(1, false);
+    qss.front().block().toggleParam("margin");
+
+    const qss::CompiledDocument compiled{ qss::CompiledDocument::compile(qss) };
+    RESULTV("Fragments kept", compiled.totalFragments(), 3);
+    RESULTV("Enabled flags kept", compiled[1].isEnabled(), false);
+
+    const auto button = compiled[0].element(1);
+    RESULTV("Combinator kept", button.position(), qss::SelectorElement::CHILD);
+    RESULTV("Id read in place", (button.id() == QStringView{ u"ok" }), true);
+    RESULTV("Classes kept", button.classCount(), 2);
+    RESULTV("Param read in place", (button.param(0).value() == QStringView{ u"true" }), true);
+    RESULTV("Disabled params skipped by value", compiled[0].value(u"margin").isEmpty(), true);
+
+    const auto restored = compiled.toDocument();
+    auto equal = restored.totalFragments() == qss.totalFragments();
+    for (std::size_t i = 0; equal && i < qss.totalFragments(); ++i)
+    {
+        equal = restored[i] == qss[i] && restored.isEnabled(i) == qss.isEnabled(i);
+    }
+    RESULTV("Round trip is structurally equal", equal, true);
+
+    const auto path = QDir::tempPath() + "/qss_compiled_test.qssb";
+    qss::CompiledDocument::save(qss, path);
+    const auto mapped = qss::CompiledDocument::fromFile(path);
+    RESULTV("Mapped file matches", (mapped.toDocument()[0] == qss[0]), true);
+    QFile::remove(path);
+
+    auto bytes = qss::CompiledDocument::compile(qss);
+    bytes.truncate(bytes.size() - 4);
+    auto rejected = false;
+    try
+    {
+        qss::CompiledDocument truncated{ bytes };
+    }
+    catch (const qss::Exception&)
+    {
+        rejected = true;
+    }
+    RESULTV("Truncated data rejected", rejected, true);
+
+    auto rejection = [](const QByteArray& data) {
+        try
+        {
+            qss::CompiledDocument loaded{ data };
+        }
+        catch (const qss::Exception& except)
+        {
+            return except.what();
+        }
+        return QString{};
+    };
+
+    auto swapped = qss::CompiledDocument::compile(qss);
+    std::reverse(swapped.begin(), swapped.begin() + 4);
+    RESULTV("Foreign byte order named", rejection(swapped).contains("foreign byte order"), true);
+
+    auto foreign = qss::CompiledDocument::compile(qss);
+    foreign[0] = 'X';
+    RESULTV("Bad magic named", rejection(foreign).contains("bad magic"), true);
+
+    auto newer = qss::CompiledDocument::compile(qss);
+    newer[4] = 2;
+    RESULTV("Unknown version named", rejection(newer).contains("version 2"), true);
+}
+
+void TestQSSStaticDocument()
+{
+    LOG("\n\nCompiling a stylesheet literal...");
+    constexpr auto theme = QSS_LITERAL(
+        "/* theme */ QPushButton#ok[flat=\"true\"]:hover { color: red; border: 1px solid \"#455364\"; }\n"
+        "QLabel { qproperty-indent: 4; image: url(:/icons/a.png) /* trailing */; }\n");
+
+    static_assert(theme.totalFragments() == 2, "Fragments counted at compile time");
+    static_assert(theme.totalDeclarations() == 4, "Declarations counted at compile time");
+    static_assert(theme[0].selector == "QPushButton#ok[flat=\"true\"]:hover", "Selector sliced at compile time");
+    static_assert(theme.value(0, qss::QSS_PROPERTY_BORDER) == "1px solid \"#455364\"", "Quoted values kept");
+    static_assert(theme.declaration(theme[1], 0).property == qss::QSS_PROPERTY_UNKNOWN, "Custom names stay unknown");
+    static_assert(theme.value(1, qss::QSS_PROPERTY_IMAGE) == "url(:/icons/a.png)", "Trailing comments dropped");
+
+    const auto document = theme.toDocument();
+    RESULTV("Adapter keeps fragments", document.totalFragments(), 2);
+    RESULTSTR("Adapter keeps values", document[1].block().value("qproperty-indent"), "4");
+    RESULTV("Adapter matches the runtime parser", (document[0] == qss::Fragment{ "QPushButton#ok[flat=\"true\"]:hover { color: red; border: 1px solid \"#455364\"; }" }), true);
+
+    auto rejected = false;
+    try
+    {
+        qss::StaticDocument<1, 0> broken{ "QLabel { color }" };
+    }
+    catch (const qss::Exception&)
+    {
+        rejected = true;
+    }
+    RESULTV("Malformed text throws outside constant evaluation", rejected, true);
+
+    // Counts given by hand are checked against the text instead of trusted
+    auto overflow = false;
+    try
+    {
+        qss::StaticDocument<1, 0> small{ "QLabel { color: red; }" };
+    }
+    catch (const qss::Exception& e)
+    {
+        overflow = e.code() == qss::Exception::BLOCK_PARAM_INVALID;
+    }
+    RESULTV("More declarations than the table holds throw", overflow, true);
+
+    auto underfilled = false;
+    try
+    {
+        qss::StaticDocument<2, 1> large{ "QLabel { color: red; }" };
+    }
+    catch (const qss::Exception& e)
+    {
+        underfilled = e.code() == qss::Exception::SELECTOR_INVALID;
+    }
+    RESULTV("Fewer fragments than the table holds throw", underfilled, true);
+}
+
+void TestQSSDiagnostics()
+{
+    LOG("\n\nParsing with diagnostics...");
+    const QString input = "QLabel { color: red; }\n"
+        "QPushButton { border 1px; color: blue; }\n"
+        "QFrame { a { b } c: d; width: 2px; }\n"
+        "/* ids */ QWidget#a#b { color: red; }\n"
+        "} QToolTip { color: white; }\n"
+        "QMenu { color: black;";
+
+    qss::Diagnostics diagnostics;
+    qss::Document document;
+    document.parse(input, diagnostics);
+    RESULTV("Good fragments kept", document.totalFragments(), 4);
+    RESULTSTR("Declaration after a bad one kept", document[1].block().value("color"), "blue");
+    RESULTV("Declaration holding a block dropped", document[2].block().size(), 1);
+    RESULTV("Fragment after a stray bracket kept", (document[3].selector() == qss::Selector{ "QToolTip" }), true);
+    RESULTV("Problems recorded", diagnostics.size(), 5);
+
+    const std::vector<std::tuple<int, int, int>> expected{
+        { qss::Exception::BLOCK_PARAM_INVALID, 2, 15 }, { qss::Exception::BLOCK_BRACKETS_INVALID, 3, 12 },
+        { qss::Exception::MULTIPLE_IDS, 4, 11 }, { qss::Exception::BLOCK_BRACKETS_INVALID, 5, 1 },
+        { qss::Exception::BLOCK_BRACKETS_INVALID, 6, 1 }
+    };
+    auto located = diagnostics.size() == expected.size();
+    for (std::size_t i = 0; located && i < expected.size(); ++i)
+    {
+        located = std::make_tuple(diagnostics[i].code, diagnostics[i].line, diagnostics[i].column) == expected[i];
+    }
+    RESULTV("Codes, lines and columns", located, true);
+
+    qss::Diagnostics utf8;
+    const auto fromUtf8 = qss::Document::fromUtf8(input.toUtf8(), utf8);
+    RESULTV("UTF-8 recovers the same fragments", (fromUtf8[2] == document[2] && fromUtf8.totalFragments() == 4), true);
+    RESULTV("UTF-8 recovers the same problems", (utf8.size() == 5 && utf8[2].offset == diagnostics[2].offset), true);
+
+    // The two byte é moves the UTF-8 offset of the bad declaration one past the UTF-16 one
+    const QString accented = QString::fromUtf8("QLabel#caf\xC3\xA9 { border 1px; }");
+    qss::Diagnostics wide;
+    qss::Diagnostics narrow;
+    qss::Document{}.parse(accented, wide);
+    qss::Document::fromUtf8(accented.toUtf8(), narrow);
+    RESULTV("UTF-8 offsets count bytes", (wide.size() == 1 && narrow.size() == 1 && narrow[0].offset == wide[0].offset + 1), true);
+    RESULTV("UTF-8 columns count bytes too", (narrow.size() == 1 && narrow[0].line == wide[0].line && narrow[0].column == wide[0].column + 1), true);
+
+    qss::Diagnostics unclosed;
+    qss::Document{}.parse("QLabel { }\n} QMenu { color: black;", unclosed);
+    RESULTV("Unclosed block after a stray bracket located", (unclosed.size() == 2 && unclosed[1].line == 2 && unclosed[1].column == 3), true);
+
+    qss::Diagnostics clean;
+    qss::Document recovered;
+    recovered.parse("QLabel { color: red; } QFrame { width: 2px; }", clean);
+    RESULTV("Clean input records nothing", clean.empty(), true);
+    RESULTV("Clean input parses as usual", (recovered[1] == qss::Document{ "QLabel { color: red; } QFrame { width: 2px; }" }[1]), true);
+
+    auto thrown = false;
+    try
+    {
+        qss::Document strict{ input };
+    }
+    catch (const qss::Exception& e)
+    {
+        thrown = e.code() == qss::Exception::BLOCK_PARAM_INVALID;
+    }
+    RESULTV("Plain parse still throws", thrown, true);
+}
+
+void TestQSSInstrument()
+{
+    LOG("\n\nInstrumenting a parse...");
+    qss::Instrument::reset();
+    qss::Instrument::enable();
+    qss::Instrument::startTrace();
+    const qss::Document document{ "QLabel { color: red; } QFrame > QLabel { width: 2px; height: 3px; }" };
+    const auto text = document.toString();
+    qss::Instrument::stopTrace();
+    qss::Instrument::enable(false);
+    qss::Document{ "QLabel { color: red; }" };
+
+    const auto trace = qss::Instrument::traceEvents();
+#ifdef QSS_INSTRUMENT
+    RESULTV("Fragments counted", qss::Instrument::counter(qss::Instrument::FRAGMENTS), 2);
+    RESULTV("Properties counted", qss::Instrument::counter(qss::Instrument::PROPERTIES), 3);
+    RESULTV("Selector parses timed", qss::Instrument::phase(qss::Instrument::SELECTOR_PARSE).calls, 2);
+    RESULTV("Nested writes timed once per pass", qss::Instrument::phase(qss::Instrument::SERIALIZE).calls, 2);
+    RESULTV("Trace holds complete events", trace.contains("\"ph\":\"X\""), true);
+    RESULTV("Trace ends with the counters", trace.contains("\"fragments\":2"), true);
+#else
+    RESULTV("Compiled out without QSS_INSTRUMENT", qss::Instrument::counter(qss::Instrument::FRAGMENTS), 0);
+    RESULTV("Trace is empty", trace.contains("\"ph\":\"X\""), false);
+#endif
+    qss::Instrument::reset();
+}
+
+// Counts what a document draws from it, passing the work on to the heap
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+
+    std::size_t allocations = 0;
+    std::size_t live = 0;
+
+private:
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++allocations;
+        live += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override
+    {
+        live -= bytes;
+        std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+void TestQSSArena()
+{
+    LOG("\n\nAllocating documents from a resource...");
+    const QString text = "QPushButton.flat#ok[default=\"true\"] { color: red; border: none; }\n"
+        "QFrame > QLabel::indicator:checked { width: 2px; }";
+
+    CountingResource counting;
+    {
+        qss::Document document{ &counting };
+        document.parse(text);
+        RESULTV("Fragments drawn from the resource", (counting.allocations > 0 && counting.live > 0), true);
+        RESULTV("Blocks share it", (document[0].block().get_allocator().resource() == &counting), true);
+        RESULTV("Selector elements share it", (document[1].selector()[1].classes().get_allocator().resource() == &counting &&
+            document[0].selector()[0].params().get_allocator().resource() == &counting), true);
+        RESULTV("Same model as on the heap", (document[0] == qss::Document{ text }[0] && document[1] == qss::Document{ text }[1]), true);
+
+        const auto copy = document;
+        RESULTV("Copies use the default resource", (copy.resource() == std::pmr::get_default_resource() && copy[1] == document[1]), true);
+    }
+    RESULTV("Everything given back", counting.live, 0);
+
+    auto arena = qss::Document::withArena();
+    const auto* resource = arena.resource();
+    arena.parse(text);
+    RESULTV("Arena documents own their resource", (resource != std::pmr::get_default_resource()), true);
+
+    qss::Document target;
+    target.parse("QLabel { color: blue; }");
+    target = std::move(arena);
+    RESULTV("Moving in takes the arena along", (target.resource() == resource && target.totalFragments() == 2), true);
+    RESULTSTR("Values survive the move", target[0].block().value("color"), "red");
+
+    auto replacement = qss::Document::withArena();
+    replacement.parse("QLabel { color: green; }");
+    target = std::move(replacement);
+    RESULTSTR("Replacing an arena document", target[0].block().value("color"), "green");
+
+    target += "QFrame { width: 1px; }";
+    RESULTV("Arena documents stay mutable", target.totalFragments(), 2);
+}
+
+void TestQSSMoves()
+{
+    LOG("\n\nMoving parts into a document...");
+    CountingResource counting;
+    const qss::Allocator allocator{ &counting };
+
+    auto build = [&allocator](const QString& name)
+    {
+        qss::Selector selector{ allocator };
+        selector.emplace(qss::SelectorElement::PARENT, QString{ "QFrame.panel[flat=\"true\"]" });
+        selector.emplace(qss::SelectorElement::CHILD, name);
+        qss::PropertyBlock block{ allocator };
+        block.addParam("color", "red").addParam("margin", "2px");
+        return qss::Fragment{ std::move(selector), std::move(block) };
+    };
+
+    qss::Document copied{ &counting };
+    auto fragment = build("QLabel#title");
+    auto before = counting.allocations;
+    copied.addFragment(fragment);
+    const auto copies = counting.allocations - before;
+
+    qss::Document moved{ &counting };
+    fragment = build("QLabel#title");
+    const auto* params = &*fragment.block().cbegin();
+    const auto* classes = fragment.selector()[0].classes().data();
+    before = counting.allocations;
+    moved.addFragment(std::move(fragment));
+    const auto moves = counting.allocations - before;
+
+    RESULTV("Moving allocates less than copying", (moves < copies), true);
+    RESULTV("Blocks are taken over", (&*moved[0].block().cbegin() == params), true);
+    RESULTV("Selector elements are taken over", (moved[0].selector()[0].classes().data() == classes), true);
+    RESULTV("Same fragment either way", (moved[0] == copied[0]), true);
+    RESULTV("Nothing left behind", (fragment.selector().fragmentCount() == 0 && fragment.block().size() == 0), true);
+
+    auto extra = build("QLabel#title");
+    extra.block().addParam("padding", "1px");
+    moved.addFragment(std::move(extra));
+    RESULTV("Moving into an existing selector merges", moved.totalFragments(), 1);
+    RESULTSTR("Merged params kept", moved[0].block().value("padding"), "1px");
+
+    qss::Document emplaced{ &counting };
+    emplaced.emplaceFragment("QLabel { color: red; }");
+    emplaced.emplaceFragment(std::move(build("QLabel#title").selector()), qss::PropertyBlock{ "color: blue;" });
+    emplaced.emplaceFragment("QLabel { margin: 1px; }");
+    RESULTV("Emplaced fragments merge too", emplaced.totalFragments(), 2);
+    RESULTSTR("Emplaced values", emplaced[0].block().value("margin"), "1px");
+    RESULTV("Emplaced fragments use the resource", (emplaced[0].block().get_allocator().resource() == &counting), true);
+
+    const qss::Selector selector{ "QFrame > QCheckBox.small::indicator" };
+    qss::Selector assigned;
+    assigned = selector;
+    RESULTV("Assignment keeps classes and sub-controls", (assigned == selector && assigned[1].classCount() == 1 &&
+        assigned[1].subControl() == selector[1].subControl()), true);
+
+    qss::SelectorElement indicator{ "QCheckBox.small::indicator:checked" };
+    qss::SelectorElement element;
+    element = std::move(indicator);
+    RESULTSTR("Moved element", element.toString(), "QCheckBox.small::indicator:checked");
+
+    auto sum = qss::Document{ "QLabel { color: red; }" } + qss::Document{ "QFrame { color: blue; }" };
+    RESULTV("Sum of temporaries", sum.totalFragments(), 2);
+}
+
+void TestQSSSnapshots()
+{
+    LOG("\n\nSharing snapshots between versions...");
+    const QString text = "QLabel { color: red; }\nQFrame { margin: 1px; }\nQLabel#title { color: blue; }";
+    qss::Document document{ text };
+    const qss::Snapshot first{ document };
+
+    RESULTV("Fragments taken", first.totalFragments(), 3);
+    RESULTV("Same text as the document", (first.toString() == document.toString()), true);
+    RESULTSTR("Values", first.value("QLabel", "color"), "red");
+
+    auto second = first.withFragment(1, qss::Fragment{ "QFrame { margin: 2px; }" });
+    RESULTSTR("New version changed", second[1].block().value("margin"), "2px");
+    RESULTSTR("Old version kept", first[1].block().value("margin"), "1px");
+    RESULTV("Unchanged fragments shared", (second.fragment(0) == first.fragment(0) && second.fragment(2) == first.fragment(2)), true);
+    RESULTV("Each version has its generation", (second.generation() != first.generation()), true);
+
+    const auto third = second.withEnabled(0, false);
+    RESULTV("Disabling shares the fragment", (third.fragment(0) == second.fragment(0) && !third.isEnabled(0) && second.isEnabled(0)), true);
+    RESULTSTR("Disabled fragments skipped", third.value("QLabel", "color"), "");
+
+    qss::Snapshot large;
+    std::vector<qss::Snapshot> history;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        history.push_back(large);
+        large = large.withAppended(qss::Fragment{ QString{ "QLabel#l%1 { width: %1px; }" }.arg(i) });
+    }
+
+    auto checked = true;
+    auto index = 0;
+
+    for (const auto& entry : large)
+    {
+        checked = checked && entry.fragment->block().value("width") == QString::number(index++) + "px";
+    }
+
+    RESULTV("Appends across levels", (checked && index == 2000 && large.totalFragments() == 2000), true);
+    RESULTV("Undo history keeps every version", (history[1000].totalFragments() == 1000 && history[1000].fragment(999) == large.fragment(999)), true);
+
+    const auto edited = large.withFragment(1500, qss::Fragment{ "QLabel#edited { width: 0px; }" });
+    RESULTV("Deep edits share the rest", (edited.fragment(1499) == large.fragment(1499) && edited.find("QLabel#edited").front() == 1500), true);
+
+    const auto removed = edited.withoutFragment(0).withInserted(10, qss::Fragment{ "QFrame { width: 3px; }" });
+    RESULTV("Removal and insertion", (removed.totalFragments() == 2000 && removed.fragment(0) == large.fragment(1) &&
+        removed.find("QFrame").front() == 10 && removed.find("QLabel#edited").front() == 1500), true);
+    RESULTV("Back to a document", (removed.toDocument().toString() == removed.toString()), true);
+
+    auto indexed = true;
+
+    for (std::size_t i = 0; i < removed.totalFragments(); ++i)
+    {
+        const auto found = removed.find(removed[i].selector().toString());
+        indexed = indexed && std::find(found.cbegin(), found.cend(), i) != found.cend();
+    }
+
+    RESULTV("Every fragment found through the index", indexed, true);
+    RESULTV("Replaced selector leaves the index", (edited.find("QLabel#l1500").empty() && large.find("QLabel#l1500").front() == 1500), true);
+
+    const auto repeated = first.withAppended(qss::Fragment{ "QLabel { color: green; }" });
+    RESULTV("Repeated selectors indexed in order", (repeated.find("QLabel") == std::vector<std::size_t>{ 0, 3 }), true);
+    RESULTSTR("Last repeated selector wins", repeated.value("QLabel", "color"), "green");
+
+    // A matcher copies the version it reads, so it outlives the caller's copy
+    const qss::Matcher matcher{ first.withEnabled(0, false) };
+    qss::Element title;
+    title.type = "QLabel";
+    title.id = "title";
+    RESULTV("Matcher reads a snapshot", (matcher.match(title) == std::vector<std::size_t>{ 2 }), true);
+
+    auto arena = qss::Document::withArena();
+    arena.parse(text);
+    const qss::Snapshot moved{ std::move(arena) };
+    arena = qss::Document{};
+    RESULTSTR("Fragments leave the arena", moved.value("QLabel#title", "color"), "blue");
+
+    // Every version sets the same width on both fragments, so a reader
+    // seeing different widths would have seen a partial commit
+    qss::SharedDocument shared{ qss::Snapshot{ qss::Document{ "QLabel { width: 0px; }\nQFrame { width: 0px; }" } } };
+    std::atomic<bool> done{ false };
+    std::atomic<int> torn{ 0 };
+    std::vector<std::thread> readers;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        readers.emplace_back([&shared, &done, &torn, i]() {
+            auto same = [](const qss::Snapshot& snapshot) {
+                return snapshot[0].block().value("width") == snapshot[1].block().value("width");
+            };
+
+            while (!done)
+            {
+                if (i % 2 == 0 ? !same(shared.snapshot()) : !shared.read(same))
+                {
+                    ++torn;
+                }
+            }
+        });
+    }
+
+    for (int i = 1; i <= 500; ++i)
+    {
+        shared.update([i](const qss::Snapshot& current) {
+            const auto width = QString{ "width: %1px;" }.arg(i);
+            return current.withFragment(0, qss::Fragment{ "QLabel { " + width + " }" })
+                .withFragment(1, qss::Fragment{ "QFrame { " + width + " }" });
+        });
+    }
+
+    // The readers never pause, yet replaced versions are freed as soon as
+    // none of them has one pinned
+    for (int i = 0; i < 1000 && shared.retiredVersions() > 8; ++i)
+    {
+        shared.publish(shared.snapshot());
+        std::this_thread::yield();
+    }
+
+    RESULTV("Versions freed under continuous reads", (shared.retiredVersions() <= 8), true);
+    done = true;
+
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+
+    RESULTV("Readers never see a partial commit", torn.load(), 0);
+    RESULTSTR("Last commit published", shared.snapshot().value("QFrame", "width"), "500px");
+
+    // A reader that stays pinned holds back its own version only
+    std::atomic<bool> pinned{ false };
+    std::atomic<bool> release{ false };
+    QString held;
+    std::thread slow{ [&shared, &pinned, &release, &held]() {
+        shared.read([&pinned, &release, &held](const qss::Snapshot& snapshot) {
+            pinned = true;
+
+            while (!release)
+            {
+                std::this_thread::yield();
+            }
+
+            held = snapshot.value("QFrame", "width");
+        });
+    } };
+
+    while (!pinned)
+    {
+        std::this_thread::yield();
+    }
+
+    for (int i = 0; i < 100; ++i)
+    {
+        shared.update([](const qss::Snapshot& current) {
+            return current.withFragment(1, qss::Fragment{ "QFrame { width: 1px; }" });
+        });
+    }
+
+    RESULTV("Later versions freed past a pinned reader", (shared.retiredVersions() <= 2), true);
+    release = true;
+    slow.join();
+    RESULTSTR("Pinned version intact", held, "500px");
+    shared.publish(shared.snapshot());
+    RESULTV("Unpinned version freed", (shared.retiredVersions() <= 2), true);
+
+    shared.publish(first);
+    RESULTSTR("Undo by publishing an old version", shared.snapshot().value("QFrame", "margin"), "1px");
+}
+
 int main(int argc, char *argv[])
 {
     using qss::operator<<;
@@ -84,6 +1159,31 @@ int main(int argc, char *argv[])
         TestQSSParts();
         TestQSSText();
         TestQSSParse();
+        TestQSSLexer();
+        TestQSSDocumentView();
+        TestQSSStreamParser();
+        TestQSSParallelParse();
+        TestQSSUtf8();
+        TestQSSMatcher();
+        TestQSSCascade();
+        TestQSSStyleCache();
+        TestQSSAtom();
+        TestQSSKnownProperties();
+        TestQSSTypedValues();
+        TestQSSPropertyOrder();
+        TestQSSSelectorIndex();
+        TestQSSInheritable();
+        TestQSSStructuralEquality();
+        TestQSSBulkRemoval();
+        TestQSSIncrementalEdit();
+        TestQSSWriter();
+        TestQSSCompiledDocument();
+        TestQSSStaticDocument();
+        TestQSSDiagnostics();
+        TestQSSInstrument();
+        TestQSSArena();
+        TestQSSMoves();
+        TestQSSSnapshots();
     }
     catch (const qss::Exception& except)
     {